@@ -0,0 +1,564 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Measures the time from starting cobalt until it has exec'd the browser. Each
+// run uses a fabricated Flatpak under COBALT_ROOT_OVERRIDE, a private session
+// bus with a stand-in Flatpak portal, and a stub browser that records when it
+// was started. Results are written to stdout as JSON.
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define APP_ID "org.cobalt.Bench"
+#define APP_NAME "bench"
+
+#define PORTAL_NAME "org.freedesktop.portal.Flatpak"
+#define PORTAL_OBJECT "/org/freedesktop/portal/Flatpak"
+#define PORTAL_PROPERTY_VERSION "version"
+#define PORTAL_PROPERTY_SUPPORTS "supports"
+#define PORTAL_VERSION 6
+#define PORTAL_SUPPORTS_EXPOSE_PIDS 1
+
+#define DBUS_NAME_FLAG_DO_NOT_QUEUE 4
+#define DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER 1
+
+#define STAMP_ENV "COBALT_BENCH_STAMP"
+#define ROOT_OVERRIDE_ENV "COBALT_ROOT_OVERRIDE"
+
+#define DEFAULT_ITERATIONS 10
+#define LARGE_FLAGS_FILE_LINES 20000
+#define SLOW_PORTAL_LATENCY_MS 200
+
+// Exit code that tells meson the benchmark was skipped.
+#define EXIT_SKIP 77
+
+typedef struct Scenario {
+  const char *name;
+  gboolean with_config;
+  guint flags_file_lines;
+  guint portal_latency_ms;
+} Scenario;
+
+static const Scenario SCENARIOS[] = {
+    {"default", TRUE, 0, 0},
+    {"large-flags-file", TRUE, LARGE_FLAGS_FILE_LINES, 0},
+    {"missing-config", FALSE, 0, 0},
+    {"slow-portal", TRUE, 0, SLOW_PORTAL_LATENCY_MS},
+};
+
+static const char FLATPAK_INFO[] = "[Application]\n"
+                                   "name=" APP_ID "\n"
+                                   "runtime=runtime/org.freedesktop.Platform/x86_64/24.08\n"
+                                   "\n"
+                                   "[Instance]\n"
+                                   "flatpak-version=1.16.0\n"
+                                   "runtime-commit=0000000000000000\n";
+
+static const char DESKTOP_FILE[] = "[Desktop Entry]\n"
+                                   "Type=Application\n"
+                                   "Name=Bench\n"
+                                   "Exec=/app/bin/" APP_NAME " %U\n";
+
+// Everything that spawns a detached helper is turned off, since those would keep
+// running past an iteration (and the font warm-up would scan the host's fonts),
+// skewing the timings of the ones after it.
+static const char CONFIG_FILE[] = "[Application]\n"
+                                  "Name=" APP_NAME "\n"
+                                  "WrapperScript=/app/bin/" APP_NAME "\n"
+                                  "ConfigDir=Bench\n"
+                                  "ExposePids=required\n"
+                                  "\n"
+                                  "[Fonts]\n"
+                                  "WarmUp=false\n"
+                                  "\n"
+                                  "[Maintenance]\n"
+                                  "Enabled=false\n"
+                                  "\n"
+                                  "[ProfileInRam]\n"
+                                  "Enabled=false\n"
+                                  "\n"
+                                  "[Watchdog]\n"
+                                  "Enabled=false\n";
+
+static const char PORTAL_XML[] =
+    "<node>"
+    "  <interface name='" PORTAL_NAME "'>"
+    "    <property name='" PORTAL_PROPERTY_VERSION "' type='u' access='read'/>"
+    "    <property name='" PORTAL_PROPERTY_SUPPORTS "' type='u' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+typedef struct Bench {
+  const char *cobalt;
+  const char *stub_browser;
+  guint iterations;
+
+  char *work_dir;
+  char *root;
+  guint home_count;
+
+  GTestDBus *bus;
+  GDBusConnection *portal_connection;
+  GMainContext *portal_context;
+  GMainLoop *portal_loop;
+  GThread *portal_thread;
+} Bench;
+
+static gint portal_latency_ms = 0;
+
+static GVariant *portal_get_property(GDBusConnection *connection, const char *sender,
+                                     const char *object_path,
+                                     const char *interface_name,
+                                     const char *property_name, GError **error,
+                                     gpointer user_data) {
+  if (g_str_equal(property_name, PORTAL_PROPERTY_VERSION)) {
+    // The portal runs on its own thread, so this only holds up the client.
+    guint latency = g_atomic_int_get(&portal_latency_ms);
+    if (latency != 0) {
+      g_usleep(latency * G_TIME_SPAN_MILLISECOND);
+    }
+
+    return g_variant_new_uint32(PORTAL_VERSION);
+  } else if (g_str_equal(property_name, PORTAL_PROPERTY_SUPPORTS)) {
+    return g_variant_new_uint32(PORTAL_SUPPORTS_EXPOSE_PIDS);
+  }
+
+  g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s",
+              property_name);
+  return NULL;
+}
+
+static const GDBusInterfaceVTable PORTAL_VTABLE = {
+    .get_property = portal_get_property,
+};
+
+static gpointer portal_thread_func(gpointer user_data) {
+  Bench *bench = user_data;
+
+  g_main_context_push_thread_default(bench->portal_context);
+  g_main_loop_run(bench->portal_loop);
+  g_main_context_pop_thread_default(bench->portal_context);
+  return NULL;
+}
+
+static gboolean register_portal(Bench *bench, GError **error) {
+  bench->portal_connection = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(bench->bus),
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+      NULL, NULL, error);
+  if (bench->portal_connection == NULL) {
+    return FALSE;
+  }
+
+  g_autoptr(GDBusNodeInfo) node_info = g_dbus_node_info_new_for_xml(PORTAL_XML, error);
+  if (node_info == NULL) {
+    return FALSE;
+  }
+
+  if (g_dbus_connection_register_object(bench->portal_connection, PORTAL_OBJECT,
+                                        node_info->interfaces[0], &PORTAL_VTABLE, NULL,
+                                        NULL, error) == 0) {
+    return FALSE;
+  }
+
+  g_autoptr(GVariant) result = g_dbus_connection_call_sync(
+      bench->portal_connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+      "org.freedesktop.DBus", "RequestName",
+      g_variant_new("(su)", PORTAL_NAME, DBUS_NAME_FLAG_DO_NOT_QUEUE),
+      G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, error);
+  if (result == NULL) {
+    return FALSE;
+  }
+
+  guint32 reply = 0;
+  g_variant_get(result, "(u)", &reply);
+  if (reply != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS, "Failed to own %s", PORTAL_NAME);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean start_portal(Bench *bench, GError **error) {
+  bench->bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bench->bus);
+
+  // Everything the portal's connection dispatches goes to the thread-default
+  // context at the time the object is registered, i.e. the portal thread.
+  bench->portal_context = g_main_context_new();
+  bench->portal_loop = g_main_loop_new(bench->portal_context, FALSE);
+
+  g_main_context_push_thread_default(bench->portal_context);
+  gboolean registered = register_portal(bench, error);
+  g_main_context_pop_thread_default(bench->portal_context);
+  if (!registered) {
+    return FALSE;
+  }
+
+  bench->portal_thread = g_thread_new("portal", portal_thread_func, bench);
+  return TRUE;
+}
+
+static void stop_portal(Bench *bench) {
+  if (bench->portal_thread != NULL) {
+    g_main_loop_quit(bench->portal_loop);
+    g_thread_join(g_steal_pointer(&bench->portal_thread));
+  }
+
+  g_clear_object(&bench->portal_connection);
+  g_clear_pointer(&bench->portal_loop, g_main_loop_unref);
+  g_clear_pointer(&bench->portal_context, g_main_context_unref);
+
+  if (bench->bus != NULL) {
+    g_test_dbus_down(bench->bus);
+    g_clear_object(&bench->bus);
+  }
+}
+
+static gboolean make_directory(const char *path, int mode, GError **error) {
+  if (g_mkdir_with_parents(path, mode) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean write_file(const char *path, const char *contents, gssize length,
+                           GError **error) {
+  g_autofree char *parent = g_path_get_dirname(path);
+  return make_directory(parent, 0755, error) &&
+         g_file_set_contents(path, contents, length, error);
+}
+
+static void remove_tree(const char *path) {
+  g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+  if (dir != NULL) {
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+      g_autofree char *child = g_build_filename(path, name, NULL);
+      if (g_file_test(child, G_FILE_TEST_IS_DIR) &&
+          !g_file_test(child, G_FILE_TEST_IS_SYMLINK)) {
+        remove_tree(child);
+      } else {
+        unlink(child);
+      }
+    }
+  }
+
+  rmdir(path);
+}
+
+static gboolean setup_root(Bench *bench, GError **error) {
+  bench->root = g_build_filename(bench->work_dir, "root", NULL);
+
+  g_autofree char *flatpak_info = g_build_filename(bench->root, ".flatpak-info", NULL);
+  if (!write_file(flatpak_info, FLATPAK_INFO, -1, error)) {
+    return FALSE;
+  }
+
+  g_autofree char *desktop_file = g_build_filename(
+      bench->root, "app", "share", "applications", APP_ID ".desktop", NULL);
+  if (!write_file(desktop_file, DESKTOP_FILE, -1, error)) {
+    return FALSE;
+  }
+
+  g_autofree char *bin_dir = g_build_filename(bench->root, "app", "bin", NULL);
+  g_autofree char *entry_point_dir = g_build_filename(bench->root, "app", APP_NAME, NULL);
+  if (!make_directory(bin_dir, 0755, error) ||
+      !make_directory(entry_point_dir, 0755, error)) {
+    return FALSE;
+  }
+
+  // Where cobalt infers the entry point to be.
+  g_autofree char *entry_point = g_build_filename(entry_point_dir, APP_NAME, NULL);
+  if (symlink(bench->stub_browser, entry_point) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to link '%s': %s", entry_point, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  // Without a config file, the font warm-up stays enabled, so it finds this
+  // instead of rebuilding the font caches of the host.
+  g_autofree char *fc_cache = g_build_filename(bin_dir, "fc-cache", NULL);
+  if (!write_file(fc_cache, "#!/bin/sh\nexit 0\n", -1, error)) {
+    return FALSE;
+  }
+
+  if (chmod(fc_cache, 0755) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to make '%s' executable: %s", fc_cache, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean setup_config(Bench *bench, const Scenario *scenario, GError **error) {
+  g_autofree char *config_file =
+      g_build_filename(bench->root, "app", "etc", "cobalt.ini", NULL);
+  if (!scenario->with_config) {
+    unlink(config_file);
+    return TRUE;
+  }
+
+  return write_file(config_file, CONFIG_FILE, -1, error);
+}
+
+static char *new_home(Bench *bench, const Scenario *scenario, GError **error) {
+  g_autofree char *name = g_strdup_printf("home-%u", bench->home_count++);
+  g_autofree char *home = g_build_filename(bench->work_dir, name, NULL);
+
+  const char *subdirs[] = {"config", "data", "cache"};
+  for (gsize i = 0; i < G_N_ELEMENTS(subdirs); i++) {
+    g_autofree char *path = g_build_filename(home, subdirs[i], NULL);
+    if (!make_directory(path, 0700, error)) {
+      return NULL;
+    }
+  }
+
+  g_autofree char *runtime_dir = g_build_filename(home, "runtime", NULL);
+  if (!make_directory(runtime_dir, 0700, error)) {
+    return NULL;
+  }
+
+  if (scenario->flags_file_lines != 0) {
+    g_autoptr(GString) contents = g_string_new(NULL);
+    for (guint i = 0; i < scenario->flags_file_lines; i++) {
+      switch (i % 4) {
+      case 0:
+        g_string_append_printf(contents, "# Comment %u\n", i);
+        break;
+      case 1:
+        g_string_append_printf(contents, "--bench-flag-%u=value-%u\n", i, i);
+        break;
+      case 2:
+        g_string_append_printf(contents, "features+=BenchFeature%u\n", i);
+        break;
+      case 3:
+        g_string_append_printf(contents, "features-=BenchFeature%u\n", i - 1);
+        break;
+      }
+    }
+
+    g_autofree char *flags_file =
+        g_build_filename(home, "config", APP_NAME "-flags.conf", NULL);
+    if (!write_file(flags_file, contents->str, contents->len, error)) {
+      return NULL;
+    }
+  }
+
+  return g_steal_pointer(&home);
+}
+
+static GStrv build_environment(Bench *bench, const char *home, const char *stamp) {
+  GStrv env = g_get_environ();
+
+  g_autofree char *config_home = g_build_filename(home, "config", NULL);
+  g_autofree char *data_home = g_build_filename(home, "data", NULL);
+  g_autofree char *cache_home = g_build_filename(home, "cache", NULL);
+  g_autofree char *runtime_dir = g_build_filename(home, "runtime", NULL);
+  g_autofree char *data_dirs = g_build_filename(bench->root, "app", "share", NULL);
+  g_autofree char *bin_dir = g_build_filename(bench->root, "app", "bin", NULL);
+  g_autofree char *path =
+      g_strdup_printf("%s:%s", bin_dir, g_environ_getenv(env, "PATH") ?: "/usr/bin");
+
+  env = g_environ_setenv(env, ROOT_OVERRIDE_ENV, bench->root, TRUE);
+  env = g_environ_setenv(env, STAMP_ENV, stamp, TRUE);
+  env = g_environ_setenv(env, "DBUS_SESSION_BUS_ADDRESS",
+                         g_test_dbus_get_bus_address(bench->bus), TRUE);
+  env = g_environ_setenv(env, "HOME", home, TRUE);
+  env = g_environ_setenv(env, "XDG_CONFIG_HOME", config_home, TRUE);
+  env = g_environ_setenv(env, "XDG_DATA_HOME", data_home, TRUE);
+  env = g_environ_setenv(env, "XDG_CACHE_HOME", cache_home, TRUE);
+  env = g_environ_setenv(env, "XDG_RUNTIME_DIR", runtime_dir, TRUE);
+  env = g_environ_setenv(env, "XDG_DATA_DIRS", data_dirs, TRUE);
+  env = g_environ_setenv(env, "PATH", path, TRUE);
+
+  // Without a display, cobalt never shows any dialogs.
+  env = g_environ_unsetenv(env, "DISPLAY");
+  env = g_environ_unsetenv(env, "WAYLAND_DISPLAY");
+  env = g_environ_unsetenv(env, "COBALT_CONFIG_OVERRIDE");
+  env = g_environ_unsetenv(env, "COBALT_PRESET");
+
+  return env;
+}
+
+static gboolean run_once(Bench *bench, const char *home, gint64 *latency,
+                         GError **error) {
+  g_autofree char *stamp = g_build_filename(home, "stamp", NULL);
+  unlink(stamp);
+
+  g_auto(GStrv) env = build_environment(bench, home, stamp);
+  const char *argv[] = {bench->cobalt, NULL};
+
+  int wait_status = 0;
+  gint64 start = g_get_monotonic_time();
+  if (!g_spawn_sync(NULL, (char **)argv, env, G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL,
+                    NULL, NULL, &wait_status, error)) {
+    return FALSE;
+  }
+
+  if (!WIFEXITED(wait_status) || WEXITSTATUS(wait_status) != 0) {
+    g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                "cobalt failed with wait status %d", wait_status);
+    return FALSE;
+  }
+
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(stamp, &contents, NULL, error)) {
+    g_prefix_error(error, "Stub browser was not started: ");
+    return FALSE;
+  }
+
+  *latency = g_ascii_strtoll(contents, NULL, 10) - start;
+  return TRUE;
+}
+
+static int compare_int64(gconstpointer a, gconstpointer b) {
+  gint64 lhs = *(const gint64 *)a;
+  gint64 rhs = *(const gint64 *)b;
+  return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static void append_result(GString *json, const Scenario *scenario, const char *mode,
+                          GArray *samples) {
+  g_array_sort(samples, compare_int64);
+
+  gint64 total = 0;
+  for (guint i = 0; i < samples->len; i++) {
+    total += g_array_index(samples, gint64, i);
+  }
+
+  if (json->str[json->len - 1] == '}') {
+    g_string_append(json, ",");
+  }
+
+  g_string_append_printf(
+      json,
+      "\n    {\"scenario\": \"%s\", \"mode\": \"%s\", \"iterations\": %u, "
+      "\"min_us\": %" G_GINT64_FORMAT ", \"median_us\": %" G_GINT64_FORMAT
+      ", \"mean_us\": %" G_GINT64_FORMAT ", \"max_us\": %" G_GINT64_FORMAT
+      ", \"samples_us\": [",
+      scenario->name, mode, samples->len, g_array_index(samples, gint64, 0),
+      g_array_index(samples, gint64, samples->len / 2), total / samples->len,
+      g_array_index(samples, gint64, samples->len - 1));
+
+  for (guint i = 0; i < samples->len; i++) {
+    g_string_append_printf(json, "%s%" G_GINT64_FORMAT, i == 0 ? "" : ", ",
+                           g_array_index(samples, gint64, i));
+  }
+
+  g_string_append(json, "]}");
+}
+
+static gboolean run_scenario(Bench *bench, const Scenario *scenario, GString *json,
+                             GError **error) {
+  if (!setup_config(bench, scenario, error)) {
+    return FALSE;
+  }
+
+  g_atomic_int_set(&portal_latency_ms, scenario->portal_latency_ms);
+
+  // Cold launches each get a fresh home, as on the very first launch after
+  // installing.
+  g_autoptr(GArray) cold = g_array_new(FALSE, FALSE, sizeof(gint64));
+  for (guint i = 0; i < bench->iterations; i++) {
+    g_autofree char *home = new_home(bench, scenario, error);
+    gint64 latency = 0;
+    if (home == NULL || !run_once(bench, home, &latency, error)) {
+      return FALSE;
+    }
+
+    g_array_append_val(cold, latency);
+  }
+
+  // Warm launches share a home that has already been launched from once.
+  g_autoptr(GArray) warm = g_array_new(FALSE, FALSE, sizeof(gint64));
+  g_autofree char *home = new_home(bench, scenario, error);
+  gint64 latency = 0;
+  if (home == NULL || !run_once(bench, home, &latency, error)) {
+    return FALSE;
+  }
+
+  for (guint i = 0; i < bench->iterations; i++) {
+    if (!run_once(bench, home, &latency, error)) {
+      return FALSE;
+    }
+
+    g_array_append_val(warm, latency);
+  }
+
+  append_result(json, scenario, "cold", cold);
+  append_result(json, scenario, "warm", warm);
+  return TRUE;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    g_printerr("usage: %s COBALT STUB-BROWSER [ITERATIONS]\n", argv[0]);
+    return 1;
+  }
+
+  g_autofree char *dbus_daemon = g_find_program_in_path("dbus-daemon");
+  if (dbus_daemon == NULL) {
+    g_printerr("dbus-daemon is not available, skipping\n");
+    return EXIT_SKIP;
+  }
+
+  g_autoptr(GError) error = NULL;
+
+  Bench bench = {0};
+  bench.cobalt = argv[1];
+  bench.stub_browser = argv[2];
+  bench.iterations = argc == 4 ? g_ascii_strtoull(argv[3], NULL, 10) : DEFAULT_ITERATIONS;
+  if (bench.iterations == 0) {
+    g_printerr("Invalid iteration count: %s\n", argv[3]);
+    return 1;
+  }
+
+  bench.work_dir = g_dir_make_tmp("cobalt-launch-bench-XXXXXX", &error);
+  if (bench.work_dir == NULL) {
+    g_printerr("Failed to create work dir: %s\n", error->message);
+    return 1;
+  }
+
+  int status = 0;
+  g_autoptr(GString) json = g_string_new("{\n  \"benchmark\": \"launch\",\n");
+  g_string_append_printf(json, "  \"results\": [");
+
+  if (!setup_root(&bench, &error) || !start_portal(&bench, &error)) {
+    g_printerr("Failed to set up: %s\n", error->message);
+    status = 1;
+    goto out;
+  }
+
+  for (gsize i = 0; i < G_N_ELEMENTS(SCENARIOS); i++) {
+    if (!run_scenario(&bench, &SCENARIOS[i], json, &error)) {
+      g_printerr("Scenario '%s' failed: %s\n", SCENARIOS[i].name, error->message);
+      status = 1;
+      goto out;
+    }
+  }
+
+  g_string_append(json, "\n  ]\n}\n");
+  g_print("%s", json->str);
+
+out:
+  stop_portal(&bench);
+  remove_tree(bench.work_dir);
+  g_free(bench.work_dir);
+  g_free(bench.root);
+  return status;
+}
@@ -0,0 +1,261 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Microbenchmarks for CobaltLauncher's internals on synthetic large inputs,
+// reporting the time and number of heap allocations per operation.
+
+#include "cobalt-launcher-private.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Each case runs until it has spent this much time in the measured operation,
+// but at least MIN_ITERATIONS times.
+#define TIME_BUDGET_NS (200 * 1000 * 1000)
+#define MIN_ITERATIONS 3
+
+#define ENTRY_POINT "/app/bench/bench"
+#define WRAPPER_SCRIPT "/app/bin/bench"
+
+// glibc's own allocator, which the wrappers below forward to.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+// Only the benchmark's own thread allocates while measuring, so there's no need
+// for atomics here.
+static guint64 allocation_count = 0;
+
+void *malloc(size_t size) {
+  allocation_count++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  allocation_count++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  allocation_count++;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) { __libc_free(ptr); }
+
+typedef struct Timer {
+  guint64 iterations;
+  guint64 elapsed_ns;
+  guint64 allocations;
+
+  guint64 start_ns;
+  guint64 start_allocations;
+} Timer;
+
+static guint64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+// Everything between these two calls counts as one operation; any setup each
+// iteration needs should happen outside of them.
+static void timer_start(Timer *timer) {
+  timer->start_allocations = allocation_count;
+  timer->start_ns = now_ns();
+}
+
+static void timer_stop(Timer *timer) {
+  guint64 end_ns = now_ns();
+  timer->elapsed_ns += end_ns - timer->start_ns;
+  timer->allocations += allocation_count - timer->start_allocations;
+  timer->iterations++;
+}
+
+typedef void (*BenchFunc)(Timer *timer, guint size, const char *path);
+
+typedef struct BenchCase {
+  const char *name;
+  BenchFunc func;
+  guint size;
+  // For cases that read a file, the size of that file in bytes.
+  gsize file_size;
+} BenchCase;
+
+static CobaltLauncher *new_launcher(void) {
+  return cobalt_launcher_new(NULL, ENTRY_POINT, WRAPPER_SCRIPT);
+}
+
+static GStrv make_features(guint count) {
+  GStrv features = g_new0(char *, count + 1);
+  for (guint i = 0; i < count; i++) {
+    features[i] = g_strdup_printf("BenchFeature%u", i);
+  }
+
+  return features;
+}
+
+static void add_features(CobaltLauncher *launcher, guint count) {
+  g_auto(GStrv) features = make_features(count);
+  for (guint i = 0; i < count; i++) {
+    cobalt_launcher_set_feature(launcher, features[i],
+                                i % 2 == 0 ? COBALT_LAUNCHER_FEATURE_ENABLED
+                                           : COBALT_LAUNCHER_FEATURE_DISABLED);
+  }
+}
+
+static void bench_set_feature(Timer *timer, guint size, const char *path) {
+  g_autoptr(CobaltLauncher) launcher = new_launcher();
+  g_auto(GStrv) features = make_features(size);
+
+  // Setting every feature twice covers both inserting and replacing.
+  timer_start(timer);
+  cobalt_launcher_set_features(launcher, features, COBALT_LAUNCHER_FEATURE_ENABLED);
+  cobalt_launcher_set_features(launcher, features, COBALT_LAUNCHER_FEATURE_DISABLED);
+  timer_stop(timer);
+}
+
+static void bench_format_features(Timer *timer, guint size, const char *path) {
+  g_autoptr(CobaltLauncher) launcher = new_launcher();
+  add_features(launcher, size);
+
+  timer_start(timer);
+  g_autofree char *flag =
+      cobalt_launcher_format_features_as_flag(launcher, COBALT_LAUNCHER_FEATURE_ENABLED);
+  timer_stop(timer);
+}
+
+static void bench_split_features(Timer *timer, guint size, const char *path) {
+  g_autoptr(CobaltLauncher) launcher = new_launcher();
+  g_auto(GStrv) features = make_features(size);
+  g_autofree char *value = g_strjoinv(",", features);
+
+  timer_start(timer);
+  cobalt_launcher_set_features_from_flag_value(launcher, value,
+                                               COBALT_LAUNCHER_FEATURE_ENABLED);
+  timer_stop(timer);
+}
+
+static void bench_build_argv(Timer *timer, guint size, const char *path) {
+  g_autoptr(CobaltLauncher) launcher = new_launcher();
+  add_features(launcher, size / 10);
+  for (guint i = 0; i < size; i++) {
+    g_autofree char *arg = g_strdup_printf("--bench-flag-%u=value", i);
+    cobalt_launcher_add_arg(launcher, arg);
+  }
+
+  timer_start(timer);
+  g_autoptr(GPtrArray) argv = cobalt_launcher_build_argv(launcher);
+  timer_stop(timer);
+}
+
+static void bench_read_flags_file(Timer *timer, guint size, const char *path) {
+  g_autoptr(CobaltLauncher) launcher = new_launcher();
+  g_autoptr(GFile) file = g_file_new_for_path(path);
+  g_autoptr(GError) error = NULL;
+
+  timer_start(timer);
+  gboolean success = cobalt_launcher_read_flags_file(launcher, file, &error);
+  timer_stop(timer);
+
+  if (!success) {
+    g_error("Failed to read '%s': %s", path, error->message);
+  }
+}
+
+static const BenchCase CASES[] = {
+    {"set_feature/1000", bench_set_feature, 1000},
+    {"set_feature/10000", bench_set_feature, 10000},
+    {"format_features_as_flag/1000", bench_format_features, 1000},
+    {"format_features_as_flag/10000", bench_format_features, 10000},
+    {"set_features_from_flag_value/1000", bench_split_features, 1000},
+    {"set_features_from_flag_value/10000", bench_split_features, 10000},
+    {"build_argv/1000", bench_build_argv, 1000},
+    {"build_argv/100000", bench_build_argv, 100000},
+    {"read_flags_file/1KB", bench_read_flags_file, 0, 1024},
+    {"read_flags_file/100KB", bench_read_flags_file, 0, 100 * 1024},
+    {"read_flags_file/1MB", bench_read_flags_file, 0, 1024 * 1024},
+    {"read_flags_file/10MB", bench_read_flags_file, 0, 10 * 1024 * 1024},
+};
+
+static char *write_flags_file(const char *dir, gsize size, GError **error) {
+  g_autoptr(GString) contents = g_string_sized_new(size + 64);
+  for (guint i = 0; contents->len < size; i++) {
+    switch (i % 4) {
+    case 0:
+      g_string_append_printf(contents, "# Comment %u\n", i);
+      break;
+    case 1:
+      g_string_append_printf(contents, "--bench-flag-%u='quoted value %u'\n", i, i);
+      break;
+    case 2:
+      g_string_append_printf(contents, "features+=BenchFeature%u\n", i);
+      break;
+    case 3:
+      g_string_append_printf(contents, "features-=BenchFeature%u\n", i - 1);
+      break;
+    }
+  }
+
+  g_autofree char *name = g_strdup_printf("flags-%" G_GSIZE_FORMAT ".conf", size);
+  g_autofree char *path = g_build_filename(dir, name, NULL);
+  if (!g_file_set_contents(path, contents->str, contents->len, error)) {
+    return NULL;
+  }
+
+  return g_steal_pointer(&path);
+}
+
+static void run_case(const BenchCase *bench_case, const char *path) {
+  Timer timer = {0};
+  while (timer.iterations < MIN_ITERATIONS || timer.elapsed_ns < TIME_BUDGET_NS) {
+    bench_case->func(&timer, bench_case->size, path);
+  }
+
+  g_print("%-40s %10" G_GUINT64_FORMAT " %16.1f ns/op %14.1f allocs/op\n",
+          bench_case->name, timer.iterations,
+          (double)timer.elapsed_ns / timer.iterations,
+          (double)timer.allocations / timer.iterations);
+}
+
+int main(int argc, char **argv) {
+  g_autoptr(GError) error = NULL;
+
+  g_autofree char *work_dir = g_dir_make_tmp("cobalt-launcher-bench-XXXXXX", &error);
+  if (work_dir == NULL) {
+    g_printerr("Failed to create work dir: %s\n", error->message);
+    return 1;
+  }
+
+  int status = 0;
+  for (gsize i = 0; i < G_N_ELEMENTS(CASES); i++) {
+    const BenchCase *bench_case = &CASES[i];
+    if (argc > 1 && !g_strv_contains((const char *const *)argv + 1, bench_case->name)) {
+      continue;
+    }
+
+    g_autofree char *path = NULL;
+    if (bench_case->file_size != 0) {
+      path = write_flags_file(work_dir, bench_case->file_size, &error);
+      if (path == NULL) {
+        g_printerr("Failed to write flags file: %s\n", error->message);
+        status = 1;
+        break;
+      }
+    }
+
+    run_case(bench_case, path);
+
+    if (path != NULL) {
+      unlink(path);
+    }
+  }
+
+  rmdir(work_dir);
+  return status;
+}
@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Stands in for the browser in the launch benchmark: it records when it was
+// started into the file named by COBALT_BENCH_STAMP, and exits immediately.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STAMP_ENV "COBALT_BENCH_STAMP"
+
+int main(int argc, char **argv) {
+  // Taken before anything else, in the same clock as g_get_monotonic_time().
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const char *stamp_path = getenv(STAMP_ENV);
+  if (stamp_path == NULL) {
+    fprintf(stderr, STAMP_ENV " is not set\n");
+    return 1;
+  }
+
+  FILE *stamp = fopen(stamp_path, "w");
+  if (stamp == NULL) {
+    perror(stamp_path);
+    return 1;
+  }
+
+  fprintf(stamp, "%lld\n", (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+  fclose(stamp);
+  return 0;
+}
@@ -0,0 +1,222 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-affinity.h"
+
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SYSFS_CPU_CAPACITY_FORMAT "devices/system/cpu/cpu%d/cpu_capacity"
+#define SYSFS_CPU_MAX_FREQ_FORMAT "devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq"
+#define SYSFS_NODE_DIR "devices/system/node"
+#define SYSFS_NODE_PREFIX "node"
+#define SYSFS_NODE_CPULIST "cpulist"
+
+// From <linux/mempolicy.h>, which isn't safe to include alongside <sched.h>.
+#define MPOL_PREFERRED 1
+
+static gboolean get_allowed_cpus(cpu_set_t *allowed, GError **error) {
+  CPU_ZERO(allowed);
+  if (sched_getaffinity(0, sizeof(*allowed), allowed) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to get current affinity: %s", g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean read_cpu_performance(int cpu, guint64 *performance) {
+  // cpu_capacity is only present on asymmetric systems (big.LITTLE and hybrid
+  // x86 on recent kernels), so fall back to the maximum frequency.
+  const char *formats[] = {SYSFS_CPU_CAPACITY_FORMAT, SYSFS_CPU_MAX_FREQ_FORMAT};
+  for (gsize i = 0; i < G_N_ELEMENTS(formats); i++) {
+    g_autofree char *relative_path = g_strdup_printf(formats[i], cpu);
+    g_autofree char *path = cobalt_util_get_sysfs_path(relative_path);
+    if (cobalt_util_read_uint64_file(path, performance, NULL)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean compute_performance_cpus(const cpu_set_t *allowed, guint threshold,
+                                         cpu_set_t *cpus) {
+  guint64 performances[CPU_SETSIZE] = {0};
+  guint64 max_performance = 0;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, allowed)) {
+      continue;
+    }
+
+    if (!read_cpu_performance(cpu, &performances[cpu])) {
+      g_debug("No capacity or frequency information for CPU %d", cpu);
+      return FALSE;
+    }
+
+    max_performance = MAX(max_performance, performances[cpu]);
+  }
+
+  CPU_ZERO(cpus);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, allowed) && performances[cpu] * 100 >= max_performance * threshold) {
+      CPU_SET(cpu, cpus);
+    }
+  }
+
+  if (CPU_EQUAL(cpus, allowed)) {
+    g_debug("All allowed CPUs are performance CPUs");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean parse_cpu_list(const char *list, cpu_set_t *cpus) {
+  CPU_ZERO(cpus);
+
+  g_auto(GStrv) ranges = g_strsplit(list, ",", -1);
+  for (char **range = ranges; *range != NULL; range++) {
+    g_strstrip(*range);
+    if (**range == '\0') {
+      continue;
+    }
+
+    guint64 first = 0, last = 0;
+    g_auto(GStrv) bounds = g_strsplit(*range, "-", 2);
+    if (!g_ascii_string_to_unsigned(bounds[0], 10, 0, CPU_SETSIZE - 1, &first, NULL)) {
+      return FALSE;
+    }
+
+    if (bounds[1] == NULL) {
+      last = first;
+    } else if (!g_ascii_string_to_unsigned(bounds[1], 10, first, CPU_SETSIZE - 1, &last,
+                                           NULL)) {
+      return FALSE;
+    }
+
+    for (guint64 cpu = first; cpu <= last; cpu++) {
+      CPU_SET(cpu, cpus);
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean compute_numa_node_cpus(const cpu_set_t *allowed, int requested_node,
+                                       cpu_set_t *cpus, int *chosen_node) {
+  g_autofree char *nodes_path = cobalt_util_get_sysfs_path(SYSFS_NODE_DIR);
+  g_autoptr(GDir) dir = g_dir_open(nodes_path, 0, NULL);
+  if (dir == NULL) {
+    g_debug("No NUMA information available");
+    return FALSE;
+  }
+
+  int node_count = 0;
+  int best_node = -1;
+  int best_count = 0;
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    guint64 node = 0;
+    if (!g_str_has_prefix(name, SYSFS_NODE_PREFIX) ||
+        !g_ascii_string_to_unsigned(name + strlen(SYSFS_NODE_PREFIX), 10, 0,
+                                    CPU_SETSIZE - 1, &node, NULL)) {
+      continue;
+    }
+
+    g_autofree char *cpulist_path =
+        g_build_filename(nodes_path, name, SYSFS_NODE_CPULIST, NULL);
+    g_autofree char *cpulist = NULL;
+    cpu_set_t node_cpus;
+    if (!g_file_get_contents(cpulist_path, &cpulist, NULL, NULL) ||
+        !parse_cpu_list(cpulist, &node_cpus)) {
+      g_debug("Failed to read CPUs of NUMA node %d", (int)node);
+      continue;
+    }
+
+    node_count++;
+    CPU_AND(&node_cpus, &node_cpus, allowed);
+    int count = CPU_COUNT(&node_cpus);
+
+    gboolean is_better = FALSE;
+    if (requested_node == -1) {
+      // Prefer the node with the most usable CPUs, breaking ties by node ID so
+      // the choice doesn't depend on directory order.
+      is_better = count > best_count ||
+                  (count == best_count && count > 0 && (int)node < best_node);
+    } else {
+      is_better = (int)node == requested_node;
+    }
+
+    if (is_better) {
+      best_node = node;
+      best_count = count;
+      memcpy(cpus, &node_cpus, sizeof(*cpus));
+    }
+  }
+
+  if (node_count < 2 && requested_node == -1) {
+    g_debug("Only one NUMA node is present");
+    return FALSE;
+  }
+
+  if (best_node == -1 || best_count == 0) {
+    g_debug("No allowed CPUs on the requested NUMA node");
+    return FALSE;
+  }
+
+  *chosen_node = best_node;
+  return TRUE;
+}
+
+gboolean cobalt_affinity_compute(CobaltAffinityPolicy policy, int numa_node,
+                                 guint performance_threshold, CobaltAffinity *affinity,
+                                 GError **error) {
+  cpu_set_t allowed;
+  if (!get_allowed_cpus(&allowed, error)) {
+    return FALSE;
+  }
+
+  affinity->numa_node = -1;
+
+  switch (policy) {
+  case COBALT_AFFINITY_POLICY_NONE:
+    return FALSE;
+  case COBALT_AFFINITY_POLICY_PERFORMANCE:
+    return compute_performance_cpus(&allowed, performance_threshold, &affinity->cpus);
+  case COBALT_AFFINITY_POLICY_NUMA_NODE:
+    return compute_numa_node_cpus(&allowed, numa_node, &affinity->cpus,
+                                  &affinity->numa_node);
+  }
+
+  g_warn_if_reached();
+  return FALSE;
+}
+
+void cobalt_affinity_apply(const CobaltAffinity *affinity) {
+  g_debug("Pinning to %d CPU(s)", CPU_COUNT(&affinity->cpus));
+  if (sched_setaffinity(0, sizeof(affinity->cpus), &affinity->cpus) == -1) {
+    g_warning("Failed to set CPU affinity: %s", g_strerror(errno));
+  }
+
+  if (affinity->numa_node != -1) {
+    g_debug("Preferring memory from NUMA node %d", affinity->numa_node);
+
+    unsigned long nodemask[CPU_SETSIZE / (8 * sizeof(unsigned long))] = {0};
+    nodemask[affinity->numa_node / (8 * sizeof(unsigned long))] |=
+        1UL << (affinity->numa_node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask,
+                sizeof(nodemask) * 8) == -1) {
+      g_warning("Failed to set memory policy: %s", g_strerror(errno));
+    }
+  }
+}
@@ -0,0 +1,35 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+#include <sched.h>
+
+typedef enum CobaltAffinityPolicy CobaltAffinityPolicy;
+typedef struct CobaltAffinity CobaltAffinity;
+
+enum CobaltAffinityPolicy {
+  COBALT_AFFINITY_POLICY_NONE,
+  // Pin to the CPUs with the highest capacity / maximum frequency.
+  COBALT_AFFINITY_POLICY_PERFORMANCE,
+  // Pin to the CPUs (and prefer the memory) of a single NUMA node.
+  COBALT_AFFINITY_POLICY_NUMA_NODE,
+};
+
+struct CobaltAffinity {
+  cpu_set_t cpus;
+  // The NUMA node to prefer memory from, or -1 if none.
+  int numa_node;
+};
+
+// Computes the affinity for the given policy, restricted to the calling
+// process's current affinity mask. Returns FALSE if the affinity should be
+// left unchanged (e.g. the topology is homogeneous) or on error; the error is
+// only set in the latter case.
+gboolean cobalt_affinity_compute(CobaltAffinityPolicy policy, int numa_node,
+                                 guint performance_threshold, CobaltAffinity *affinity,
+                                 GError **error);
+
+void cobalt_affinity_apply(const CobaltAffinity *affinity);
@@ -0,0 +1,446 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-cache.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-profile.h"
+#include "cobalt-sched.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_RUNTIME_SUBDIR "cobalt-cache"
+
+#define STATE_GROUP_GPU "GPU"
+#define STATE_GPU_DRIVER_FINGERPRINT "DriverFingerprint"
+
+#define STALE_SUFFIX ".cobalt-stale"
+
+#define HELPER_NICE 19
+
+// The GPU caches don't have any command line switches to relocate them, so
+// they're replaced with symlinks into the cache location instead. Paths are
+// relative to the browser's config dir.
+static const char *GPU_CACHE_DIRS[] = {
+    "ShaderCache",
+    "GrShaderCache",
+    "GraphiteDawnCache",
+    NULL,
+};
+
+// Each profile has its own GPU cache on top of the shared ones above.
+#define PROFILE_GPU_CACHE_DIR "GPUCache"
+
+// Directories under the runtime's GL extension point whose contents decide
+// which driver ends up being loaded. Only file names and sizes are hashed for
+// the DRI drivers, since they're large; the ICD files are small and include the
+// driver versions, so their contents are hashed too.
+static const char *GL_DRIVER_LISTING_DIRS[] = {
+    "lib/dri",
+    "lib/gbm",
+    NULL,
+};
+
+static const char *GL_DRIVER_CONTENT_DIRS[] = {
+    "vulkan/icd.d",
+    "glvnd/egl_vendor.d",
+    NULL,
+};
+
+static char *get_cache_base_dir(CobaltConfig *config) {
+  const char *subdir = config->application.config_dir != NULL
+                           ? config->application.config_dir
+                           : config->application.name;
+
+  switch (config->cache.location) {
+  case COBALT_CONFIG_CACHE_LOCATION_PROFILE:
+    return NULL;
+  case COBALT_CONFIG_CACHE_LOCATION_CACHE:
+    return g_build_filename(g_get_user_cache_dir(), subdir, NULL);
+  case COBALT_CONFIG_CACHE_LOCATION_RUNTIME:
+    return g_build_filename(g_get_user_runtime_dir(), CACHE_RUNTIME_SUBDIR, subdir,
+                            NULL);
+  }
+
+  g_warn_if_reached();
+  return NULL;
+}
+
+static gboolean make_directory(const char *path, GError **error) {
+  if (g_mkdir_with_parents(path, 0700) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+// Returns every GPU cache path relative to profile_dir, including the ones of
+// profiles that already exist.
+static GPtrArray *list_gpu_cache_dirs(const char *profile_dir) {
+  GPtrArray *dirs = g_ptr_array_new_with_free_func(g_free);
+  for (const char **dir = GPU_CACHE_DIRS; *dir != NULL; dir++) {
+    g_ptr_array_add(dirs, g_strdup(*dir));
+  }
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    g_autofree char *profile = g_path_get_basename(profiles->pdata[i]);
+    g_ptr_array_add(dirs, g_build_filename(profile, PROFILE_GPU_CACHE_DIR, NULL));
+  }
+
+  return dirs;
+}
+
+static gboolean link_gpu_cache_dir(const char *link, const char *target, GError **error) {
+  if (!make_directory(target, error)) {
+    return FALSE;
+  }
+
+  if (g_file_test(link, G_FILE_TEST_IS_SYMLINK)) {
+    g_autofree char *current_target = g_file_read_link(link, NULL);
+    if (g_strcmp0(current_target, target) == 0) {
+      return TRUE;
+    }
+  }
+
+  // Anything already in the way is only a cache, so it can safely be thrown
+  // away. This only happens once, the first time the location is changed.
+  if (!cobalt_util_remove_tree(link, error)) {
+    return FALSE;
+  }
+
+  g_autofree char *link_parent = g_path_get_dirname(link);
+  if (!make_directory(link_parent, error)) {
+    return FALSE;
+  }
+
+  if (symlink(target, link) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to link '%s' to '%s': %s", link, target, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  g_debug("Linked GPU cache '%s' to '%s'", link, target);
+  return TRUE;
+}
+
+static gboolean relocate_gpu_caches(const char *profile_dir, const char *base_dir,
+                                    GError **error) {
+  if (profile_dir == NULL) {
+    g_debug("ConfigDir is not set, not relocating GPU caches");
+    return TRUE;
+  }
+
+  g_autoptr(GPtrArray) dirs = list_gpu_cache_dirs(profile_dir);
+  for (guint i = 0; i < dirs->len; i++) {
+    g_autofree char *link = g_build_filename(profile_dir, dirs->pdata[i], NULL);
+    g_autofree char *target = g_build_filename(base_dir, dirs->pdata[i], NULL);
+    if (!link_gpu_cache_dir(link, target, error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static guint64 compute_size_cap(CobaltConfig *config, const char *target) {
+  guint64 cap = 0;
+
+  if (config->cache.max_size_percent != 0) {
+    g_autoptr(GError) local_error = NULL;
+    guint64 free_space = 0;
+    if (cobalt_util_get_free_space(target, &free_space, &local_error)) {
+      cap = free_space / 100 * config->cache.max_size_percent;
+      g_debug("Cache location '%s' has %" G_GUINT64_FORMAT " bytes free, cap is %u%%",
+              target, free_space, config->cache.max_size_percent);
+    } else {
+      g_warning("Failed to compute cache size cap: %s", local_error->message);
+    }
+  }
+
+  if (config->cache.max_size_mb != 0) {
+    guint64 max_size = config->cache.max_size_mb * 1024 * 1024;
+    if (cap == 0 || cap > max_size) {
+      cap = max_size;
+    }
+  }
+
+  return cap;
+}
+
+gboolean cobalt_cache_setup(CobaltConfig *config, const char *profile_dir,
+                            CobaltLauncher *launcher, GError **error) {
+  g_autofree char *base_dir = get_cache_base_dir(config);
+  if (base_dir != NULL) {
+    if (!make_directory(base_dir, error)) {
+      return FALSE;
+    }
+
+    g_autofree char *disk_cache_dir_flag =
+        g_strdup_printf("--disk-cache-dir=%s", base_dir);
+    cobalt_launcher_add_arg(launcher, disk_cache_dir_flag);
+
+    if (!relocate_gpu_caches(profile_dir, base_dir, error)) {
+      return FALSE;
+    }
+  }
+
+  // If the caches stay in the profile, they share the config dir's filesystem.
+  const char *cap_target = base_dir != NULL ? base_dir : g_get_user_config_dir();
+  guint64 cap = compute_size_cap(config, cap_target);
+  if (cap != 0) {
+    g_debug("Capping disk cache at %" G_GUINT64_FORMAT " bytes", cap);
+
+    g_autofree char *disk_cache_size_flag =
+        g_strdup_printf("--disk-cache-size=%" G_GUINT64_FORMAT, cap);
+    cobalt_launcher_add_arg(launcher, disk_cache_size_flag);
+
+    // The GPU caches hold far less than the HTTP cache, so give them a quarter
+    // of the budget.
+    g_autofree char *gpu_cache_size_flag =
+        g_strdup_printf("--gpu-disk-cache-size-kb=%" G_GUINT64_FORMAT, cap / 4 / 1024);
+    cobalt_launcher_add_arg(launcher, gpu_cache_size_flag);
+  }
+
+  return TRUE;
+}
+
+static gboolean is_gl_extension(const char *name) {
+  return strstr(name, ".GL.") != NULL || strstr(name, ".GL32.") != NULL;
+}
+
+static void hash_gl_extensions(GChecksum *checksum, const char *extensions) {
+  // The format is NAME=COMMIT;NAME=COMMIT;...
+  g_auto(GStrv) entries = g_strsplit(extensions, ";", -1);
+  for (char **entry = entries; *entry != NULL; entry++) {
+    if (is_gl_extension(*entry)) {
+      g_checksum_update(checksum, (const guchar *)*entry, -1);
+      g_checksum_update(checksum, (const guchar *)"\n", 1);
+    }
+  }
+}
+
+static GPtrArray *list_dir(const char *path) {
+  g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+  if (dir == NULL) {
+    return NULL;
+  }
+
+  GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    g_ptr_array_add(names, g_strdup(name));
+  }
+
+  return names;
+}
+
+static int compare_names(gconstpointer a, gconstpointer b) {
+  return g_strcmp0(*(const char **)a, *(const char **)b);
+}
+
+static void hash_gl_dir(GChecksum *checksum, const char *path, gboolean contents) {
+  g_autoptr(GPtrArray) names = list_dir(path);
+  if (names == NULL) {
+    return;
+  }
+
+  g_ptr_array_sort(names, compare_names);
+
+  for (guint i = 0; i < names->len; i++) {
+    const char *name = names->pdata[i];
+    g_autofree char *child = g_build_filename(path, name, NULL);
+
+    struct stat st;
+    if (stat(child, &st) == -1 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+
+    g_autofree char *entry = g_strdup_printf("%s %" G_GINT64_FORMAT "\n", child,
+                                             (gint64)st.st_size);
+    g_checksum_update(checksum, (const guchar *)entry, -1);
+
+    if (contents) {
+      g_autofree char *data = NULL;
+      gsize length = 0;
+      if (g_file_get_contents(child, &data, &length, NULL)) {
+        g_checksum_update(checksum, (const guchar *)data, length);
+      }
+    }
+  }
+}
+
+static char *compute_gpu_driver_fingerprint(CobaltHost *host, GError **error) {
+  const char *machine = cobalt_host_get_machine(host, error);
+  if (machine == NULL) {
+    return NULL;
+  }
+
+  g_autoptr(GError) local_error = NULL;
+  const char *extensions = cobalt_host_get_runtime_extensions(host, &local_error);
+  if (local_error != NULL) {
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return NULL;
+  }
+
+  g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+  if (extensions != NULL) {
+    hash_gl_extensions(checksum, extensions);
+  }
+
+  g_autofree char *sandbox_gl_dir = g_strdup_printf("/usr/lib/%s-linux-gnu/GL", machine);
+  g_autofree char *gl_dir = cobalt_util_get_root_path(sandbox_gl_dir);
+
+  // Each mounted GL extension gets its own directory here, and e.g. the NVIDIA
+  // ones include the driver version in the name.
+  g_autoptr(GPtrArray) extension_dirs = list_dir(gl_dir);
+  if (extension_dirs != NULL) {
+    g_ptr_array_sort(extension_dirs, compare_names);
+    for (guint i = 0; i < extension_dirs->len; i++) {
+      g_checksum_update(checksum, extension_dirs->pdata[i], -1);
+      g_checksum_update(checksum, (const guchar *)"\n", 1);
+    }
+  }
+
+  for (const char **dir = GL_DRIVER_LISTING_DIRS; *dir != NULL; dir++) {
+    g_autofree char *path = g_build_filename(gl_dir, *dir, NULL);
+    hash_gl_dir(checksum, path, FALSE);
+  }
+
+  for (const char **dir = GL_DRIVER_CONTENT_DIRS; *dir != NULL; dir++) {
+    g_autofree char *path = g_build_filename(gl_dir, *dir, NULL);
+    hash_gl_dir(checksum, path, TRUE);
+  }
+
+  return g_strdup(g_checksum_get_string(checksum));
+}
+
+static gboolean move_aside(const char *path, GPtrArray *stale, GError **error) {
+  g_autofree char *stale_path =
+      g_strdup_printf("%s" STALE_SUFFIX "-%" G_GINT64_FORMAT, path, g_get_real_time());
+  if (rename(path, stale_path) == -1) {
+    int saved_errno = errno;
+    if (saved_errno == ENOENT) {
+      return TRUE;
+    }
+
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to move '%s' aside: %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  g_debug("Moved stale GPU cache '%s' to '%s'", path, stale_path);
+  g_ptr_array_add(stale, g_steal_pointer(&stale_path));
+  return TRUE;
+}
+
+static gboolean rotate_gpu_caches(const char *profile_dir, GError **error) {
+  g_autoptr(GPtrArray) stale = g_ptr_array_new_with_free_func(g_free);
+
+  g_autoptr(GPtrArray) dirs = list_gpu_cache_dirs(profile_dir);
+  for (guint i = 0; i < dirs->len; i++) {
+    g_autofree char *path = g_build_filename(profile_dir, dirs->pdata[i], NULL);
+
+    // Relocated caches are symlinks, so the link stays and its target is
+    // rotated instead. The browser recreates an empty directory either way.
+    if (g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+      g_autofree char *target = g_file_read_link(path, NULL);
+      if (target != NULL && !move_aside(target, stale, error)) {
+        return FALSE;
+      }
+
+      if (target != NULL && !make_directory(target, error)) {
+        return FALSE;
+      }
+    } else if (!move_aside(path, stale, error)) {
+      return FALSE;
+    }
+  }
+
+  if (stale->len == 0) {
+    return TRUE;
+  }
+
+  // Renaming is instant, while deleting a large cache is not, so leave that to
+  // a helper instead of holding up startup.
+  g_ptr_array_add(stale, NULL);
+  return cobalt_helper_spawnv(COBALT_CACHE_HELPER_REMOVE_STALE,
+                              (const char *const *)stale->pdata, error);
+}
+
+gboolean cobalt_cache_check_gpu_driver(CobaltHost *host, CobaltState *state,
+                                       const char *profile_dir, GError **error) {
+  if (profile_dir == NULL) {
+    g_debug("ConfigDir is not set, not checking GPU driver changes");
+    return TRUE;
+  }
+
+  g_autofree char *fingerprint = compute_gpu_driver_fingerprint(host, error);
+  if (fingerprint == NULL) {
+    g_prefix_error(error, "Failed to fingerprint GPU drivers: ");
+    return FALSE;
+  }
+
+  g_autofree char *last_fingerprint =
+      cobalt_state_get_string(state, STATE_GROUP_GPU, STATE_GPU_DRIVER_FINGERPRINT);
+  if (g_strcmp0(fingerprint, last_fingerprint) == 0) {
+    return TRUE;
+  }
+
+  // On the first launch there's nothing to compare against, but there's also
+  // no reason to believe the existing caches are stale.
+  if (last_fingerprint != NULL) {
+    // The running instance still uses the old caches, so they're rotated on the
+    // next launch that starts the browser afresh, which still sees the change.
+    if (cobalt_profile_is_running(profile_dir)) {
+      g_debug("GPU drivers changed, but the browser is running, not rotating caches");
+      return TRUE;
+    }
+
+    g_debug("GPU drivers changed (%s -> %s), rotating GPU caches", last_fingerprint,
+            fingerprint);
+    if (!rotate_gpu_caches(profile_dir, error)) {
+      return FALSE;
+    }
+  }
+
+  cobalt_state_set_string(state, STATE_GROUP_GPU, STATE_GPU_DRIVER_FINGERPRINT,
+                          fingerprint);
+  return TRUE;
+}
+
+int cobalt_cache_helper_remove_stale(int argc, char **argv) {
+  setpriority(PRIO_PROCESS, 0, HELPER_NICE);
+  cobalt_sched_set_io_priority(0, COBALT_SCHED_IO_CLASS_IDLE, 0, NULL);
+
+  int status = 0;
+  for (int i = 0; i < argc; i++) {
+    // Don't let a bad argument turn this into a general-purpose rm -rf.
+    if (strstr(argv[i], STALE_SUFFIX "-") == NULL) {
+      g_printerr("Refusing to remove '%s'\n", argv[i]);
+      status = 1;
+      continue;
+    }
+
+    g_autoptr(GError) error = NULL;
+    if (!cobalt_util_remove_tree(argv[i], &error)) {
+      g_printerr("%s\n", error->message);
+      status = 1;
+    }
+  }
+
+  return status;
+}
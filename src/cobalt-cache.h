@@ -0,0 +1,25 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+#include "cobalt-host.h"
+#include "cobalt-launcher.h"
+#include "cobalt-state.h"
+
+#include <glib.h>
+
+#define COBALT_CACHE_HELPER_REMOVE_STALE "remove-stale-caches"
+
+// Moves the GPU caches out of the way if the graphics drivers changed since
+// the last launch, since the browser is slow to reject the stale entries.
+gboolean cobalt_cache_check_gpu_driver(CobaltHost *host, CobaltState *state,
+                                       const char *profile_dir, GError **error);
+
+// profile_dir is the browser's user data dir, or NULL if it's not known.
+gboolean cobalt_cache_setup(CobaltConfig *config, const char *profile_dir,
+                            CobaltLauncher *launcher, GError **error);
+
+int cobalt_cache_helper_remove_stale(int argc, char **argv);
@@ -4,6 +4,8 @@
 
 #include "cobalt-config.h"
 
+#include "cobalt-util.h"
+
 #define CONFIG_OVERRIDE_ENV "COBALT_CONFIG_OVERRIDE"
 #define CONFIG_FILE_PATH "/app/etc/cobalt.ini"
 
@@ -15,6 +17,8 @@
 #define CONFIG_APPLICATION_CONFIG_DIR "ConfigDir"
 #define CONFIG_APPLICATION_FIRST_RUN_URLS "FirstRunUrls"
 #define CONFIG_APPLICATION_MIGRATE_FLAGS_FILE "MigrateFlagsFile"
+#define CONFIG_APPLICATION_DEFAULT_PRESET "DefaultPreset"
+#define CONFIG_APPLICATION_PROFILE_TEMPLATE "ProfileTemplate"
 
 #define CONFIG_ZYPAK "Zypak"
 #define CONFIG_ZYPAK_ENABLED "Enabled"
@@ -29,8 +33,130 @@
 #define CONFIG_DEFAULT_FEATURES_ENABLED "Enabled"
 #define CONFIG_DEFAULT_FEATURES_DISABLED "Disabled"
 
+#define CONFIG_ENVIRONMENT "Environment"
+
+#define CONFIG_CACHE "Cache"
+#define CONFIG_CACHE_LOCATION "Location"
+#define CONFIG_CACHE_MAX_SIZE_PERCENT "MaxSizePercent"
+#define CONFIG_CACHE_MAX_SIZE "MaxSize"
+
+#define CONFIG_FILESYSTEM "Filesystem"
+#define CONFIG_FILESYSTEM_NO_COW "NoCOW"
+#define CONFIG_FILESYSTEM_LOCAL_CACHES "LocalCaches"
+
+#define CONFIG_PREFETCH "Prefetch"
+#define CONFIG_PREFETCH_ENABLED "Enabled"
+#define CONFIG_PREFETCH_BUDGET "Budget"
+#define CONFIG_PREFETCH_MAX_FILE_SIZE "MaxFileSize"
+
+#define CONFIG_SHARED_MEMORY "SharedMemory"
+#define CONFIG_SHARED_MEMORY_ENABLED "Enabled"
+#define CONFIG_SHARED_MEMORY_MIN_SIZE "MinSize"
+#define CONFIG_SHARED_MEMORY_MIN_SIZE_PERCENT "MinSizePercent"
+
+#define CONFIG_PROFILE_IN_RAM "ProfileInRam"
+#define CONFIG_PROFILE_IN_RAM_ENABLED "Enabled"
+#define CONFIG_PROFILE_IN_RAM_SYNC_INTERVAL "SyncInterval"
+
+#define CONFIG_FONTS "Fonts"
+#define CONFIG_FONTS_WARM_UP "WarmUp"
+
+#define CONFIG_MAINTENANCE "Maintenance"
+#define CONFIG_MAINTENANCE_ENABLED "Enabled"
+#define CONFIG_MAINTENANCE_INTERVAL "Interval"
+#define CONFIG_MAINTENANCE_TIME_BUDGET "TimeBudget"
+#define CONFIG_MAINTENANCE_CODE_CACHE_MAX_SIZE "CodeCacheMaxSize"
+
+#define CONFIG_POWER "Power"
+#define CONFIG_POWER_ENABLED "Enabled"
+#define CONFIG_POWER_BATTERY_PRESET "BatteryPreset"
+#define CONFIG_POWER_LOW_BATTERY_PRESET "LowBatteryPreset"
+#define CONFIG_POWER_LOW_BATTERY_THRESHOLD "LowBatteryThreshold"
+#define CONFIG_POWER_LOW_POWER_PROFILE_AS_BATTERY "LowPowerProfileAsBattery"
+
+#define CONFIG_PRESSURE "Pressure"
+#define CONFIG_PRESSURE_ENABLED "Enabled"
+#define CONFIG_PRESSURE_CPU_THRESHOLD "CPUThreshold"
+#define CONFIG_PRESSURE_MEMORY_THRESHOLD "MemoryThreshold"
+#define CONFIG_PRESSURE_IO_THRESHOLD "IOThreshold"
+#define CONFIG_PRESSURE_PRESET "Preset"
+#define CONFIG_PRESSURE_DEFER_OPTIONAL_WORK "DeferOptionalWork"
+
+#define CONFIG_SESSION_RESTORE "SessionRestore"
+#define CONFIG_SESSION_RESTORE_ENABLED "Enabled"
+#define CONFIG_SESSION_RESTORE_LARGE_THRESHOLD "LargeThreshold"
+#define CONFIG_SESSION_RESTORE_LARGE_PRESET "LargePreset"
+#define CONFIG_SESSION_RESTORE_HUGE_THRESHOLD "HugeThreshold"
+#define CONFIG_SESSION_RESTORE_HUGE_PRESET "HugePreset"
+#define CONFIG_SESSION_RESTORE_DEFER_HUGE "DeferHuge"
+
+#define CONFIG_PRELOAD "Preload"
+#define CONFIG_PRELOAD_ENABLED "Enabled"
+#define CONFIG_PRELOAD_MIN_AVAILABLE_MEMORY "MinAvailableMemory"
+#define CONFIG_PRELOAD_LOW_PRIORITY_DURATION "LowPriorityDuration"
+
+#define CONFIG_SUPERVISOR "Supervisor"
+#define CONFIG_SUPERVISOR_ENABLED "Enabled"
+#define CONFIG_SUPERVISOR_INITIAL_BACKOFF "InitialBackoff"
+#define CONFIG_SUPERVISOR_MAX_BACKOFF "MaxBackoff"
+#define CONFIG_SUPERVISOR_CRASH_LOOP_LIMIT "CrashLoopLimit"
+#define CONFIG_SUPERVISOR_CRASH_LOOP_WINDOW "CrashLoopWindow"
+#define CONFIG_SUPERVISOR_CLEAN_SESSIONS "CleanSessions"
+
+#define CONFIG_WATCHDOG "Watchdog"
+#define CONFIG_WATCHDOG_ENABLED "Enabled"
+#define CONFIG_WATCHDOG_BUDGET "Budget"
+#define CONFIG_WATCHDOG_MAX_LOG_SIZE "MaxLogSize"
+
+#define CONFIG_SCHEDULING "Scheduling"
+#define CONFIG_SCHEDULING_NICE "Nice"
+#define CONFIG_SCHEDULING_POLICY "Policy"
+#define CONFIG_SCHEDULING_IO_CLASS "IOClass"
+#define CONFIG_SCHEDULING_IO_LEVEL "IOLevel"
+#define CONFIG_SCHEDULING_OOM_SCORE_ADJ "OomScoreAdj"
+#define CONFIG_SCHEDULING_TIMER_SLACK "TimerSlack"
+#define CONFIG_SCHEDULING_STARTUP_IO_BOOST "StartupIOBoost"
+
+#define CONFIG_AFFINITY "Affinity"
+#define CONFIG_AFFINITY_POLICY "Policy"
+#define CONFIG_AFFINITY_NUMA_NODE "NumaNode"
+#define CONFIG_AFFINITY_PERFORMANCE_THRESHOLD "PerformanceThreshold"
+
+#define CONFIG_PRESET_PREFIX "Preset."
+#define CONFIG_PRESET_ENABLED "Enabled"
+#define CONFIG_PRESET_DISABLED "Disabled"
+#define CONFIG_PRESET_FLAGS "Flags"
+#define CONFIG_PRESET_ENVIRONMENT "Environment"
+
 #define CONFIG_ZYPAK_WIDEVINE_PATH_DEFAULT "WidevineCdm"
 #define CONFIG_ZYPAK_MIMIC_STRATEGY_ACTION_DEFAULT COBALT_CONFIG_MIMIC_STRATEGY_WARN
+#define CONFIG_CACHE_LOCATION_DEFAULT COBALT_CONFIG_CACHE_LOCATION_PROFILE
+#define CONFIG_CACHE_MAX_SIZE_PERCENT_DEFAULT 10
+#define CONFIG_PREFETCH_BUDGET_DEFAULT 128
+#define CONFIG_PREFETCH_MAX_FILE_SIZE_DEFAULT 32
+#define CONFIG_SHARED_MEMORY_MIN_SIZE_DEFAULT 256
+#define CONFIG_SHARED_MEMORY_MIN_SIZE_PERCENT_DEFAULT 5
+#define CONFIG_PROFILE_IN_RAM_SYNC_INTERVAL_DEFAULT 15
+#define CONFIG_MAINTENANCE_INTERVAL_DEFAULT 7
+#define CONFIG_MAINTENANCE_TIME_BUDGET_DEFAULT 60
+#define CONFIG_MAINTENANCE_CODE_CACHE_MAX_SIZE_DEFAULT 256
+#define CONFIG_POWER_LOW_BATTERY_THRESHOLD_DEFAULT 20
+#define CONFIG_PRESSURE_CPU_THRESHOLD_DEFAULT 80
+#define CONFIG_PRESSURE_MEMORY_THRESHOLD_DEFAULT 10
+#define CONFIG_PRESSURE_IO_THRESHOLD_DEFAULT 30
+#define CONFIG_SESSION_RESTORE_LARGE_THRESHOLD_DEFAULT 100
+#define CONFIG_SESSION_RESTORE_HUGE_THRESHOLD_DEFAULT 500
+#define CONFIG_PRELOAD_MIN_AVAILABLE_MEMORY_DEFAULT 2048
+#define CONFIG_PRELOAD_LOW_PRIORITY_DURATION_DEFAULT 120
+#define CONFIG_SUPERVISOR_INITIAL_BACKOFF_DEFAULT 500
+#define CONFIG_SUPERVISOR_MAX_BACKOFF_DEFAULT 30000
+#define CONFIG_SUPERVISOR_CRASH_LOOP_LIMIT_DEFAULT 5
+#define CONFIG_SUPERVISOR_CRASH_LOOP_WINDOW_DEFAULT 60
+#define CONFIG_WATCHDOG_BUDGET_DEFAULT 20
+#define CONFIG_WATCHDOG_MAX_LOG_SIZE_DEFAULT 1024
+#define CONFIG_SCHEDULING_IO_LEVEL_DEFAULT 4
+#define CONFIG_AFFINITY_NUMA_NODE_AUTO "auto"
+#define CONFIG_AFFINITY_PERFORMANCE_THRESHOLD_DEFAULT 90
 
 static gboolean read_boolean(GKeyFile *key_file, const char *group, const char *key,
                              gboolean *out, gboolean *was_set, GError **error) {
@@ -58,6 +184,50 @@ static gboolean read_boolean(GKeyFile *key_file, const char *group, const char *
   return TRUE;
 }
 
+static gboolean read_uint64(GKeyFile *key_file, const char *group, const char *key,
+                            guint64 max, guint64 *out, gboolean *was_set,
+                            GError **error) {
+  g_autofree char *value = g_key_file_get_value(key_file, group, key, NULL);
+  if (value == NULL) {
+    if (was_set) {
+      *was_set = FALSE;
+    }
+    return TRUE;
+  }
+
+  if (!g_ascii_string_to_unsigned(g_strstrip(value), 10, 0, max, out, error)) {
+    g_prefix_error(error, "Value for '%s' in [%s] is not valid: ", key, group);
+    return FALSE;
+  }
+
+  if (was_set) {
+    *was_set = TRUE;
+  }
+  return TRUE;
+}
+
+static gboolean read_int64(GKeyFile *key_file, const char *group, const char *key,
+                           gint64 min, gint64 max, gint64 *out, gboolean *was_set,
+                           GError **error) {
+  g_autofree char *value = g_key_file_get_value(key_file, group, key, NULL);
+  if (value == NULL) {
+    if (was_set) {
+      *was_set = FALSE;
+    }
+    return TRUE;
+  }
+
+  if (!g_ascii_string_to_signed(g_strstrip(value), 10, min, max, out, error)) {
+    g_prefix_error(error, "Value for '%s' in [%s] is not valid: ", key, group);
+    return FALSE;
+  }
+
+  if (was_set) {
+    *was_set = TRUE;
+  }
+  return TRUE;
+}
+
 static CobaltConfigExposePids parse_expose_pids(const char *string, GError **error) {
   if (g_str_equal(string, "required")) {
     return COBALT_CONFIG_EXPOSE_PIDS_REQUIRED;
@@ -73,14 +243,533 @@ static CobaltConfigExposePids parse_expose_pids(const char *string, GError **err
   }
 }
 
+static CobaltConfigCacheLocation parse_cache_location(const char *string,
+                                                      GError **error) {
+  if (g_str_equal(string, "profile")) {
+    return COBALT_CONFIG_CACHE_LOCATION_PROFILE;
+  } else if (g_str_equal(string, "cache")) {
+    return COBALT_CONFIG_CACHE_LOCATION_CACHE;
+  } else if (g_str_equal(string, "runtime")) {
+    return COBALT_CONFIG_CACHE_LOCATION_RUNTIME;
+  } else {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "Value '%s' for '" CONFIG_CACHE_LOCATION "' is not valid", string);
+    return 0;
+  }
+}
+
+static void preset_free(CobaltConfigPreset *preset) {
+  g_clear_pointer(&preset->enabled_features, g_strfreev);
+  g_clear_pointer(&preset->disabled_features, g_strfreev);
+  g_clear_pointer(&preset->flags, g_strfreev);
+  g_clear_pointer(&preset->environment, g_ptr_array_unref);
+  g_free(preset);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CobaltConfigPreset, preset_free)
+
+static CobaltConfigPreset *read_preset(GKeyFile *key_file, const char *group,
+                                       GError **error) {
+  g_autoptr(CobaltConfigPreset) preset = g_new0(CobaltConfigPreset, 1);
+
+  preset->enabled_features =
+      g_key_file_get_string_list(key_file, group, CONFIG_PRESET_ENABLED, NULL, NULL);
+  preset->disabled_features =
+      g_key_file_get_string_list(key_file, group, CONFIG_PRESET_DISABLED, NULL, NULL);
+
+  g_autofree char *flags =
+      g_key_file_get_string(key_file, group, CONFIG_PRESET_FLAGS, NULL);
+  if (flags != NULL && !g_shell_parse_argv(flags, NULL, &preset->flags, error)) {
+    g_prefix_error(error, "Failed to parse '" CONFIG_PRESET_FLAGS "' in [%s]: ", group);
+    return NULL;
+  }
+
+  preset->environment =
+      g_ptr_array_new_with_free_func((GDestroyNotify)cobalt_env_edit_free);
+
+  g_auto(GStrv) environment =
+      g_key_file_get_string_list(key_file, group, CONFIG_PRESET_ENVIRONMENT, NULL, NULL);
+  for (char **assignment = environment; assignment && *assignment != NULL;
+       assignment++) {
+    CobaltEnvEdit *edit = cobalt_env_edit_parse_line(*assignment, error);
+    if (edit == NULL) {
+      g_prefix_error(error, "Failed to parse '" CONFIG_PRESET_ENVIRONMENT "' in [%s]: ",
+                     group);
+      return NULL;
+    }
+
+    g_ptr_array_add(preset->environment, edit);
+  }
+
+  return g_steal_pointer(&preset);
+}
+
+static gboolean read_environment(GKeyFile *key_file, GPtrArray *environment,
+                                 GError **error) {
+  g_auto(GStrv) keys = g_key_file_get_keys(key_file, CONFIG_ENVIRONMENT, NULL, NULL);
+  for (char **key = keys; key && *key != NULL; key++) {
+    // Not g_key_file_get_string, since the values are passed through verbatim
+    // rather than unescaped.
+    g_autofree char *value = g_key_file_get_value(key_file, CONFIG_ENVIRONMENT, *key, NULL);
+    CobaltEnvEdit *edit = cobalt_env_edit_parse(*key, value, error);
+    if (edit == NULL) {
+      g_prefix_error(error, "Failed to parse [" CONFIG_ENVIRONMENT "]: ");
+      return FALSE;
+    }
+
+    g_ptr_array_add(environment, edit);
+  }
+
+  return TRUE;
+}
+
+static gboolean read_presets(GKeyFile *key_file, GHashTable *presets, GError **error) {
+  g_auto(GStrv) groups = g_key_file_get_groups(key_file, NULL);
+  for (char **group = groups; *group != NULL; group++) {
+    if (!g_str_has_prefix(*group, CONFIG_PRESET_PREFIX)) {
+      continue;
+    }
+
+    const char *name = *group + strlen(CONFIG_PRESET_PREFIX);
+    if (*name == '\0') {
+      g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                  "Preset group [%s] has an empty name", *group);
+      return FALSE;
+    }
+
+    CobaltConfigPreset *preset = read_preset(key_file, *group, error);
+    if (preset == NULL) {
+      return FALSE;
+    }
+
+    g_debug("Found preset '%s'", name);
+    g_hash_table_replace(presets, g_strdup(name), preset);
+  }
+
+  return TRUE;
+}
+
+static CobaltSchedCpuPolicy parse_cpu_policy(const char *string, GError **error) {
+  if (g_str_equal(string, "other")) {
+    return COBALT_SCHED_CPU_POLICY_OTHER;
+  } else if (g_str_equal(string, "batch")) {
+    return COBALT_SCHED_CPU_POLICY_BATCH;
+  } else if (g_str_equal(string, "idle")) {
+    return COBALT_SCHED_CPU_POLICY_IDLE;
+  } else {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "Value '%s' for '" CONFIG_SCHEDULING_POLICY "' is not valid", string);
+    return 0;
+  }
+}
+
+static CobaltSchedIOClass parse_io_class(const char *string, GError **error) {
+  if (g_str_equal(string, "realtime")) {
+    return COBALT_SCHED_IO_CLASS_REALTIME;
+  } else if (g_str_equal(string, "best-effort")) {
+    return COBALT_SCHED_IO_CLASS_BEST_EFFORT;
+  } else if (g_str_equal(string, "idle")) {
+    return COBALT_SCHED_IO_CLASS_IDLE;
+  } else {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "Value '%s' for '" CONFIG_SCHEDULING_IO_CLASS "' is not valid", string);
+    return 0;
+  }
+}
+
+static gboolean read_maintenance(GKeyFile *key_file, CobaltConfig *config,
+                                 GError **error) {
+  if (!read_boolean(key_file, CONFIG_MAINTENANCE, CONFIG_MAINTENANCE_ENABLED,
+                    &config->maintenance.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  if (config->maintenance.enabled && !config->application.config_dir) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+                CONFIG_APPLICATION_CONFIG_DIR " must be set if [" CONFIG_MAINTENANCE
+                                              "] is enabled");
+    return FALSE;
+  }
+
+  guint64 interval = CONFIG_MAINTENANCE_INTERVAL_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_MAINTENANCE, CONFIG_MAINTENANCE_INTERVAL, G_MAXUINT,
+                   &interval, NULL, error)) {
+    return FALSE;
+  }
+  config->maintenance.interval = interval;
+
+  guint64 time_budget = CONFIG_MAINTENANCE_TIME_BUDGET_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_MAINTENANCE, CONFIG_MAINTENANCE_TIME_BUDGET,
+                   G_MAXUINT, &time_budget, NULL, error)) {
+    return FALSE;
+  }
+  config->maintenance.time_budget = time_budget;
+
+  config->maintenance.code_cache_max_size_mb =
+      CONFIG_MAINTENANCE_CODE_CACHE_MAX_SIZE_DEFAULT;
+  return read_uint64(key_file, CONFIG_MAINTENANCE, CONFIG_MAINTENANCE_CODE_CACHE_MAX_SIZE,
+                     G_MAXUINT64 / 1024 / 1024,
+                     &config->maintenance.code_cache_max_size_mb, NULL, error);
+}
+
+static gboolean read_power(GKeyFile *key_file, CobaltConfig *config, GError **error) {
+  if (!read_boolean(key_file, CONFIG_POWER, CONFIG_POWER_ENABLED, &config->power.enabled,
+                    NULL, error)) {
+    return FALSE;
+  }
+
+  config->power.battery_preset =
+      g_key_file_get_string(key_file, CONFIG_POWER, CONFIG_POWER_BATTERY_PRESET, NULL);
+  config->power.low_battery_preset = g_key_file_get_string(
+      key_file, CONFIG_POWER, CONFIG_POWER_LOW_BATTERY_PRESET, NULL);
+
+  guint64 low_battery_threshold = CONFIG_POWER_LOW_BATTERY_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_POWER, CONFIG_POWER_LOW_BATTERY_THRESHOLD, 100,
+                   &low_battery_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->power.low_battery_threshold = low_battery_threshold;
+
+  config->power.low_power_profile_as_battery = TRUE;
+  return read_boolean(key_file, CONFIG_POWER, CONFIG_POWER_LOW_POWER_PROFILE_AS_BATTERY,
+                      &config->power.low_power_profile_as_battery, NULL, error);
+}
+
+static gboolean read_filesystem(GKeyFile *key_file, CobaltConfig *config,
+                                GError **error) {
+  if (!read_boolean(key_file, CONFIG_FILESYSTEM, CONFIG_FILESYSTEM_NO_COW,
+                    &config->filesystem.no_cow, NULL, error)) {
+    return FALSE;
+  }
+
+  config->filesystem.local_caches = TRUE;
+  return read_boolean(key_file, CONFIG_FILESYSTEM, CONFIG_FILESYSTEM_LOCAL_CACHES,
+                      &config->filesystem.local_caches, NULL, error);
+}
+
+static gboolean read_prefetch(GKeyFile *key_file, CobaltConfig *config,
+                              GError **error) {
+  config->prefetch.enabled = TRUE;
+  if (!read_boolean(key_file, CONFIG_PREFETCH, CONFIG_PREFETCH_ENABLED,
+                    &config->prefetch.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  config->prefetch.budget_mb = CONFIG_PREFETCH_BUDGET_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PREFETCH, CONFIG_PREFETCH_BUDGET,
+                   G_MAXUINT64 / 1024 / 1024, &config->prefetch.budget_mb, NULL, error)) {
+    return FALSE;
+  }
+
+  config->prefetch.max_file_size_mb = CONFIG_PREFETCH_MAX_FILE_SIZE_DEFAULT;
+  return read_uint64(key_file, CONFIG_PREFETCH, CONFIG_PREFETCH_MAX_FILE_SIZE,
+                     G_MAXUINT64 / 1024 / 1024, &config->prefetch.max_file_size_mb, NULL,
+                     error);
+}
+
+static gboolean read_shared_memory(GKeyFile *key_file, CobaltConfig *config,
+                                   GError **error) {
+  config->shared_memory.enabled = TRUE;
+  if (!read_boolean(key_file, CONFIG_SHARED_MEMORY, CONFIG_SHARED_MEMORY_ENABLED,
+                    &config->shared_memory.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  config->shared_memory.min_size_mb = CONFIG_SHARED_MEMORY_MIN_SIZE_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SHARED_MEMORY, CONFIG_SHARED_MEMORY_MIN_SIZE,
+                   G_MAXUINT64 / 1024 / 1024, &config->shared_memory.min_size_mb, NULL,
+                   error)) {
+    return FALSE;
+  }
+
+  guint64 min_size_percent = CONFIG_SHARED_MEMORY_MIN_SIZE_PERCENT_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SHARED_MEMORY, CONFIG_SHARED_MEMORY_MIN_SIZE_PERCENT,
+                   100, &min_size_percent, NULL, error)) {
+    return FALSE;
+  }
+  config->shared_memory.min_size_percent = min_size_percent;
+
+  return TRUE;
+}
+
+static gboolean read_pressure(GKeyFile *key_file, CobaltConfig *config,
+                              GError **error) {
+  if (!read_boolean(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_ENABLED,
+                    &config->pressure.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  guint64 cpu_threshold = CONFIG_PRESSURE_CPU_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_CPU_THRESHOLD, 100,
+                   &cpu_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->pressure.cpu_threshold = cpu_threshold;
+
+  guint64 memory_threshold = CONFIG_PRESSURE_MEMORY_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_MEMORY_THRESHOLD, 100,
+                   &memory_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->pressure.memory_threshold = memory_threshold;
+
+  guint64 io_threshold = CONFIG_PRESSURE_IO_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_IO_THRESHOLD, 100,
+                   &io_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->pressure.io_threshold = io_threshold;
+
+  config->pressure.preset =
+      g_key_file_get_string(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_PRESET, NULL);
+
+  config->pressure.defer_optional_work = TRUE;
+  return read_boolean(key_file, CONFIG_PRESSURE, CONFIG_PRESSURE_DEFER_OPTIONAL_WORK,
+                      &config->pressure.defer_optional_work, NULL, error);
+}
+
+static gboolean read_session_restore(GKeyFile *key_file, CobaltConfig *config,
+                                     GError **error) {
+  if (!read_boolean(key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_ENABLED,
+                    &config->session_restore.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  if (config->session_restore.enabled && !config->application.config_dir) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+                CONFIG_APPLICATION_CONFIG_DIR " must be set if [" CONFIG_SESSION_RESTORE
+                                              "] is enabled");
+    return FALSE;
+  }
+
+  guint64 large_threshold = CONFIG_SESSION_RESTORE_LARGE_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_LARGE_THRESHOLD,
+                   G_MAXUINT, &large_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->session_restore.large_threshold = large_threshold;
+
+  guint64 huge_threshold = CONFIG_SESSION_RESTORE_HUGE_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_HUGE_THRESHOLD,
+                   G_MAXUINT, &huge_threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->session_restore.huge_threshold = huge_threshold;
+
+  config->session_restore.large_preset = g_key_file_get_string(
+      key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_LARGE_PRESET, NULL);
+  config->session_restore.huge_preset = g_key_file_get_string(
+      key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_HUGE_PRESET, NULL);
+
+  return read_boolean(key_file, CONFIG_SESSION_RESTORE, CONFIG_SESSION_RESTORE_DEFER_HUGE,
+                      &config->session_restore.defer_huge, NULL, error);
+}
+
+static gboolean read_preload(GKeyFile *key_file, CobaltConfig *config, GError **error) {
+  config->preload.enabled = TRUE;
+  if (!read_boolean(key_file, CONFIG_PRELOAD, CONFIG_PRELOAD_ENABLED,
+                    &config->preload.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  config->preload.min_available_memory_mb = CONFIG_PRELOAD_MIN_AVAILABLE_MEMORY_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PRELOAD, CONFIG_PRELOAD_MIN_AVAILABLE_MEMORY,
+                   G_MAXUINT64 / 1024 / 1024, &config->preload.min_available_memory_mb,
+                   NULL, error)) {
+    return FALSE;
+  }
+
+  guint64 low_priority_duration = CONFIG_PRELOAD_LOW_PRIORITY_DURATION_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PRELOAD, CONFIG_PRELOAD_LOW_PRIORITY_DURATION,
+                   G_MAXUINT, &low_priority_duration, NULL, error)) {
+    return FALSE;
+  }
+  config->preload.low_priority_duration = low_priority_duration;
+
+  return TRUE;
+}
+
+static gboolean read_supervisor(GKeyFile *key_file, CobaltConfig *config,
+                                GError **error) {
+  if (!read_boolean(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_ENABLED,
+                    &config->supervisor.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  guint64 initial_backoff = CONFIG_SUPERVISOR_INITIAL_BACKOFF_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_INITIAL_BACKOFF,
+                   G_MAXUINT, &initial_backoff, NULL, error)) {
+    return FALSE;
+  }
+  config->supervisor.initial_backoff = initial_backoff;
+
+  guint64 max_backoff = CONFIG_SUPERVISOR_MAX_BACKOFF_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_MAX_BACKOFF, G_MAXUINT,
+                   &max_backoff, NULL, error)) {
+    return FALSE;
+  }
+  config->supervisor.max_backoff = max_backoff;
+
+  guint64 crash_loop_limit = CONFIG_SUPERVISOR_CRASH_LOOP_LIMIT_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_CRASH_LOOP_LIMIT,
+                   G_MAXUINT, &crash_loop_limit, NULL, error)) {
+    return FALSE;
+  }
+  config->supervisor.crash_loop_limit = crash_loop_limit;
+
+  guint64 crash_loop_window = CONFIG_SUPERVISOR_CRASH_LOOP_WINDOW_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_CRASH_LOOP_WINDOW,
+                   G_MAXUINT, &crash_loop_window, NULL, error)) {
+    return FALSE;
+  }
+  config->supervisor.crash_loop_window = crash_loop_window;
+
+  return read_boolean(key_file, CONFIG_SUPERVISOR, CONFIG_SUPERVISOR_CLEAN_SESSIONS,
+                      &config->supervisor.clean_sessions, NULL, error);
+}
+
+static gboolean read_watchdog(GKeyFile *key_file, CobaltConfig *config, GError **error) {
+  if (!read_boolean(key_file, CONFIG_WATCHDOG, CONFIG_WATCHDOG_ENABLED,
+                    &config->watchdog.enabled, NULL, error)) {
+    return FALSE;
+  }
+
+  if (config->watchdog.enabled && !config->application.config_dir) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+                CONFIG_APPLICATION_CONFIG_DIR " must be set if [" CONFIG_WATCHDOG
+                                              "] is enabled");
+    return FALSE;
+  }
+
+  guint64 budget = CONFIG_WATCHDOG_BUDGET_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_WATCHDOG, CONFIG_WATCHDOG_BUDGET, G_MAXUINT, &budget,
+                   NULL, error)) {
+    return FALSE;
+  }
+  config->watchdog.budget = budget;
+
+  config->watchdog.max_log_size_kb = CONFIG_WATCHDOG_MAX_LOG_SIZE_DEFAULT;
+  return read_uint64(key_file, CONFIG_WATCHDOG, CONFIG_WATCHDOG_MAX_LOG_SIZE,
+                     G_MAXUINT64 / 1024, &config->watchdog.max_log_size_kb, NULL, error);
+}
+
+static gboolean read_scheduling(GKeyFile *key_file, CobaltSchedPolicy *policy,
+                                GError **error) {
+  g_autoptr(GError) local_error = NULL;
+  gint64 value = 0;
+
+  if (!read_int64(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_NICE, -20, 19, &value,
+                  &policy->nice_set, error)) {
+    return FALSE;
+  }
+  policy->nice = value;
+
+  g_autofree char *cpu_policy_string =
+      g_key_file_get_string(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_POLICY, NULL);
+  if (cpu_policy_string != NULL) {
+    policy->cpu_policy = parse_cpu_policy(cpu_policy_string, &local_error);
+    if (local_error) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      return FALSE;
+    }
+  }
+
+  g_autofree char *io_class_string =
+      g_key_file_get_string(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_IO_CLASS, NULL);
+  if (io_class_string != NULL) {
+    policy->io_class = parse_io_class(io_class_string, &local_error);
+    if (local_error) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      return FALSE;
+    }
+  }
+
+  value = CONFIG_SCHEDULING_IO_LEVEL_DEFAULT;
+  if (!read_int64(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_IO_LEVEL, 0, 7, &value,
+                  NULL, error)) {
+    return FALSE;
+  }
+  policy->io_level = value;
+
+  if (!read_int64(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_OOM_SCORE_ADJ, -1000,
+                  1000, &value, &policy->oom_score_adj_set, error)) {
+    return FALSE;
+  }
+  policy->oom_score_adj = value;
+
+  if (!read_uint64(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_TIMER_SLACK,
+                   G_MAXUINT64, &policy->timer_slack, NULL, error)) {
+    return FALSE;
+  }
+
+  guint64 startup_io_boost = 0;
+  if (!read_uint64(key_file, CONFIG_SCHEDULING, CONFIG_SCHEDULING_STARTUP_IO_BOOST,
+                   G_MAXUINT, &startup_io_boost, NULL, error)) {
+    return FALSE;
+  }
+  policy->startup_io_boost = startup_io_boost;
+
+  return TRUE;
+}
+
+static CobaltAffinityPolicy parse_affinity_policy(const char *string, GError **error) {
+  if (g_str_equal(string, "none")) {
+    return COBALT_AFFINITY_POLICY_NONE;
+  } else if (g_str_equal(string, "performance")) {
+    return COBALT_AFFINITY_POLICY_PERFORMANCE;
+  } else if (g_str_equal(string, "numa-node")) {
+    return COBALT_AFFINITY_POLICY_NUMA_NODE;
+  } else {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "Value '%s' for '" CONFIG_AFFINITY_POLICY "' is not valid", string);
+    return 0;
+  }
+}
+
+static gboolean read_affinity(GKeyFile *key_file, CobaltConfig *config, GError **error) {
+  g_autoptr(GError) local_error = NULL;
+
+  g_autofree char *policy_string =
+      g_key_file_get_string(key_file, CONFIG_AFFINITY, CONFIG_AFFINITY_POLICY, NULL);
+  if (policy_string != NULL) {
+    config->affinity.policy = parse_affinity_policy(policy_string, &local_error);
+    if (local_error) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      return FALSE;
+    }
+  }
+
+  config->affinity.numa_node = -1;
+  g_autofree char *numa_node_string =
+      g_key_file_get_string(key_file, CONFIG_AFFINITY, CONFIG_AFFINITY_NUMA_NODE, NULL);
+  if (numa_node_string != NULL &&
+      !g_str_equal(numa_node_string, CONFIG_AFFINITY_NUMA_NODE_AUTO)) {
+    gint64 numa_node = 0;
+    if (!read_int64(key_file, CONFIG_AFFINITY, CONFIG_AFFINITY_NUMA_NODE, 0, G_MAXINT,
+                    &numa_node, NULL, error)) {
+      return FALSE;
+    }
+    config->affinity.numa_node = numa_node;
+  }
+
+  guint64 threshold = CONFIG_AFFINITY_PERFORMANCE_THRESHOLD_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_AFFINITY, CONFIG_AFFINITY_PERFORMANCE_THRESHOLD, 100,
+                   &threshold, NULL, error)) {
+    return FALSE;
+  }
+  config->affinity.performance_threshold = threshold;
+
+  return TRUE;
+}
+
 CobaltConfig *cobalt_config_load(GError **error) {
   g_autoptr(CobaltConfig) config = g_new0(CobaltConfig, 1);
   g_autoptr(GKeyFile) key_file = g_key_file_new();
   g_autoptr(GError) local_error = NULL;
 
-  const char *path = g_getenv(CONFIG_OVERRIDE_ENV);
+  g_autofree char *path = g_strdup(g_getenv(CONFIG_OVERRIDE_ENV));
   if (path == NULL) {
-    path = CONFIG_FILE_PATH;
+    path = cobalt_util_get_root_path(CONFIG_FILE_PATH);
   }
 
   g_debug("Loading config file '%s'", path);
@@ -108,6 +797,10 @@ CobaltConfig *cobalt_config_load(GError **error) {
       key_file, CONFIG_APPLICATION, CONFIG_APPLICATION_FIRST_RUN_URLS, NULL, NULL);
   config->application.migrate_flags_file = g_key_file_get_string(
       key_file, CONFIG_APPLICATION, CONFIG_APPLICATION_MIGRATE_FLAGS_FILE, NULL);
+  config->application.default_preset = g_key_file_get_string(
+      key_file, CONFIG_APPLICATION, CONFIG_APPLICATION_DEFAULT_PRESET, NULL);
+  config->application.profile_template = g_key_file_get_string(
+      key_file, CONFIG_APPLICATION, CONFIG_APPLICATION_PROFILE_TEMPLATE, NULL);
 
   const char *expose_pids_string = g_key_file_get_string(
       key_file, CONFIG_APPLICATION, CONFIG_APPLICATION_EXPOSE_PIDS, NULL);
@@ -157,9 +850,128 @@ CobaltConfig *cobalt_config_load(GError **error) {
   config->default_features.disabled = g_key_file_get_string_list(
       key_file, CONFIG_DEFAULT_FEATURES, CONFIG_DEFAULT_FEATURES_DISABLED, NULL, NULL);
 
+  config->environment =
+      g_ptr_array_new_with_free_func((GDestroyNotify)cobalt_env_edit_free);
+  if (!read_environment(key_file, config->environment, error)) {
+    return NULL;
+  }
+
+  g_autofree char *cache_location_string =
+      g_key_file_get_string(key_file, CONFIG_CACHE, CONFIG_CACHE_LOCATION, NULL);
+  if (cache_location_string != NULL) {
+    config->cache.location = parse_cache_location(cache_location_string, &local_error);
+    if (local_error) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      return NULL;
+    }
+  } else {
+    config->cache.location = CONFIG_CACHE_LOCATION_DEFAULT;
+  }
+
+  guint64 max_size_percent = 0;
+  gboolean max_size_percent_was_set = FALSE;
+  if (!read_uint64(key_file, CONFIG_CACHE, CONFIG_CACHE_MAX_SIZE_PERCENT, 100,
+                   &max_size_percent, &max_size_percent_was_set, error)) {
+    return NULL;
+  }
+
+  if (max_size_percent_was_set) {
+    config->cache.max_size_percent = max_size_percent;
+  } else if (config->cache.location != COBALT_CONFIG_CACHE_LOCATION_PROFILE) {
+    config->cache.max_size_percent = CONFIG_CACHE_MAX_SIZE_PERCENT_DEFAULT;
+  }
+
+  if (!read_uint64(key_file, CONFIG_CACHE, CONFIG_CACHE_MAX_SIZE, G_MAXUINT64 / 1024 / 1024,
+                   &config->cache.max_size_mb, NULL, error)) {
+    return NULL;
+  }
+
+  if (!read_filesystem(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_prefetch(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_shared_memory(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_boolean(key_file, CONFIG_PROFILE_IN_RAM, CONFIG_PROFILE_IN_RAM_ENABLED,
+                    &config->profile_in_ram.enabled, NULL, error)) {
+    return NULL;
+  }
+
+  if (config->profile_in_ram.enabled && !config->application.config_dir) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+                CONFIG_APPLICATION_CONFIG_DIR " must be set if [" CONFIG_PROFILE_IN_RAM
+                                              "] is enabled");
+    return NULL;
+  }
+
+  guint64 sync_interval = CONFIG_PROFILE_IN_RAM_SYNC_INTERVAL_DEFAULT;
+  if (!read_uint64(key_file, CONFIG_PROFILE_IN_RAM, CONFIG_PROFILE_IN_RAM_SYNC_INTERVAL,
+                   G_MAXUINT, &sync_interval, NULL, error)) {
+    return NULL;
+  }
+  config->profile_in_ram.sync_interval = sync_interval;
+
+  config->fonts.warm_up = TRUE;
+  if (!read_boolean(key_file, CONFIG_FONTS, CONFIG_FONTS_WARM_UP, &config->fonts.warm_up,
+                    NULL, error)) {
+    return NULL;
+  }
+
+  if (!read_maintenance(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_power(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_pressure(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_session_restore(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_preload(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_supervisor(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_watchdog(key_file, config, error)) {
+    return NULL;
+  }
+
+  if (!read_scheduling(key_file, &config->scheduling, error)) {
+    return NULL;
+  }
+
+  if (!read_affinity(key_file, config, error)) {
+    return NULL;
+  }
+
+  config->presets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)preset_free);
+  if (!read_presets(key_file, config->presets, error)) {
+    return NULL;
+  }
+
   return g_steal_pointer(&config);
 }
 
+CobaltConfigPreset *cobalt_config_get_preset(CobaltConfig *config, const char *name) {
+  return g_hash_table_lookup(config->presets, name);
+}
+
 void cobalt_config_free(CobaltConfig *config) {
   g_clear_pointer(&config->application.name, g_free);
   g_clear_pointer(&config->application.entry_point, g_free);
@@ -167,10 +979,19 @@ void cobalt_config_free(CobaltConfig *config) {
   g_clear_pointer(&config->application.config_dir, g_free);
   g_clear_pointer(&config->application.first_run_urls, g_strfreev);
   g_clear_pointer(&config->application.migrate_flags_file, g_free);
+  g_clear_pointer(&config->application.default_preset, g_free);
+  g_clear_pointer(&config->application.profile_template, g_free);
   g_clear_pointer(&config->zypak.sandbox_filename, g_free);
   g_clear_pointer(&config->zypak.widevine_path, g_free);
   g_clear_pointer(&config->default_features.enabled, g_strfreev);
   g_clear_pointer(&config->default_features.disabled, g_strfreev);
+  g_clear_pointer(&config->environment, g_ptr_array_unref);  // NOLINT
+  g_clear_pointer(&config->power.battery_preset, g_free);
+  g_clear_pointer(&config->power.low_battery_preset, g_free);
+  g_clear_pointer(&config->pressure.preset, g_free);
+  g_clear_pointer(&config->session_restore.large_preset, g_free);
+  g_clear_pointer(&config->session_restore.huge_preset, g_free);
+  g_clear_pointer(&config->presets, g_hash_table_unref);  // NOLINT
 
   g_free(config);
 }
@@ -4,12 +4,18 @@
 
 #pragma once
 
+#include "cobalt-affinity.h"
+#include "cobalt-env.h"
+#include "cobalt-sched.h"
+
 #include <glib.h>
 
 typedef struct CobaltConfig CobaltConfig;
+typedef struct CobaltConfigPreset CobaltConfigPreset;
 
 typedef enum CobaltConfigZypakStatus CobaltConfigZypakStatus;
 typedef enum CobaltConfigExposePids CobaltConfigExposePids;
+typedef enum CobaltConfigCacheLocation CobaltConfigCacheLocation;
 
 enum CobaltConfigExposePids {
   COBALT_CONFIG_EXPOSE_PIDS_REQUIRED = 1,
@@ -17,20 +23,39 @@ enum CobaltConfigExposePids {
   COBALT_CONFIG_EXPOSE_PIDS_OPTIONAL,
 };
 
+enum CobaltConfigCacheLocation {
+  COBALT_CONFIG_CACHE_LOCATION_PROFILE = 1,
+  COBALT_CONFIG_CACHE_LOCATION_CACHE,
+  COBALT_CONFIG_CACHE_LOCATION_RUNTIME,
+};
+
+struct CobaltConfigPreset {
+  // All of these may safely be NULL.
+  GStrv enabled_features;
+  GStrv disabled_features;
+  GStrv flags;
+  // Array of CobaltEnvEdit*.
+  GPtrArray *environment;
+};
+
 struct CobaltConfig {
   struct {
-    // Must be filled with defaults externally if not set.
+    // Must be filled with defaults externally if not set, except for
+    // wrapper_script, which stays NULL when running headless.
     char *name;
     char *entry_point;
     char *wrapper_script;
     CobaltConfigExposePids expose_pids;
 
-    // Must be set if widevine.expose_widevine is set.
+    // Must be set if widevine.expose_widevine, profile_in_ram.enabled,
+    // maintenance.enabled, session_restore.enabled or watchdog.enabled is set.
     char *config_dir;
 
     // May safely be NULL.
     char **first_run_urls;
     char *migrate_flags_file;
+    char *default_preset;
+    char *profile_template;
   } application;
 
   struct {
@@ -55,9 +80,137 @@ struct CobaltConfig {
     GStrv enabled;
     GStrv disabled;
   } default_features;
+
+  // Array of CobaltEnvEdit*, in the order they appear in the config file.
+  GPtrArray *environment;
+
+  struct {
+    // Filled with defaults by the config parser.
+    CobaltConfigCacheLocation location;
+    // Percentage of the target filesystem's free space the caches may use, or 0
+    // if no caps should be set.
+    guint max_size_percent;
+    // Absolute cap in MiB, or 0 for no absolute cap.
+    guint64 max_size_mb;
+  } cache;
+
+  struct {
+    // Filled with defaults by the config parser.
+    gboolean no_cow;
+    gboolean local_caches;
+  } filesystem;
+
+  struct {
+    // All filled with defaults by the config parser. Sizes are in MiB.
+    gboolean enabled;
+    guint64 budget_mb;
+    guint64 max_file_size_mb;
+  } prefetch;
+
+  struct {
+    // All filled with defaults by the config parser. The browser is expected to
+    // need the larger of the absolute size in MiB and the percentage of total
+    // memory, either of which may be 0.
+    gboolean enabled;
+    guint64 min_size_mb;
+    guint min_size_percent;
+  } shared_memory;
+
+  struct {
+    gboolean enabled;
+    // In minutes, or 0 to only sync when the browser exits. Filled with
+    // defaults by the config parser.
+    guint sync_interval;
+  } profile_in_ram;
+
+  struct {
+    // Filled with defaults by the config parser.
+    gboolean warm_up;
+  } fonts;
+
+  struct {
+    gboolean enabled;
+    // All filled with defaults by the config parser. The interval is in days,
+    // the time budget in seconds.
+    guint interval;
+    guint time_budget;
+    guint64 code_cache_max_size_mb;
+  } maintenance;
+
+  struct {
+    gboolean enabled;
+    // The presets may safely be NULL. The rest is filled with defaults by the
+    // config parser, and the threshold is in percent.
+    char *battery_preset;
+    char *low_battery_preset;
+    guint low_battery_threshold;
+    gboolean low_power_profile_as_battery;
+  } power;
+
+  struct {
+    gboolean enabled;
+    // Filled with defaults by the config parser. Thresholds are in percent, and 0
+    // disables one. The preset may safely be NULL.
+    guint cpu_threshold;
+    guint memory_threshold;
+    guint io_threshold;
+    char *preset;
+    gboolean defer_optional_work;
+  } pressure;
+
+  struct {
+    gboolean enabled;
+    // Thresholds are in restored tabs, and filled with defaults by the config
+    // parser. The presets may safely be NULL.
+    guint large_threshold;
+    char *large_preset;
+    guint huge_threshold;
+    char *huge_preset;
+    gboolean defer_huge;
+  } session_restore;
+
+  struct {
+    // All filled with defaults by the config parser. The memory threshold is in
+    // MiB, the duration in seconds.
+    gboolean enabled;
+    guint64 min_available_memory_mb;
+    guint low_priority_duration;
+  } preload;
+
+  struct {
+    gboolean enabled;
+    // All filled with defaults by the config parser. Backoffs are in
+    // milliseconds, the window in seconds, and a limit of 0 never gives up.
+    guint initial_backoff;
+    guint max_backoff;
+    guint crash_loop_limit;
+    guint crash_loop_window;
+    gboolean clean_sessions;
+  } supervisor;
+
+  struct {
+    gboolean enabled;
+    // Filled with defaults by the config parser. The budget is in seconds.
+    guint budget;
+    guint64 max_log_size_kb;
+  } watchdog;
+
+  CobaltSchedPolicy scheduling;
+
+  struct {
+    CobaltAffinityPolicy policy;
+    // -1 to pick the node automatically.
+    int numa_node;
+    // Filled with defaults by the config parser.
+    guint performance_threshold;
+  } affinity;
+
+  // Maps preset names to CobaltConfigPreset*.
+  GHashTable *presets;
 };
 
 CobaltConfig *cobalt_config_load(GError **error);
+CobaltConfigPreset *cobalt_config_get_preset(CobaltConfig *config, const char *name);
 void cobalt_config_free(CobaltConfig *config);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(CobaltConfig, cobalt_config_free)
@@ -0,0 +1,172 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-env.h"
+
+#include <string.h>
+
+#define APPEND_SUFFIX "+"
+#define PREPEND_SUFFIX "^"
+#define UNSET_PREFIX "!"
+
+#define LIST_SEPARATOR ":"
+
+#define EXPAND_ARCH "%arch%"
+#define EXPAND_APP_ID "%app_id%"
+
+CobaltEnvEdit *cobalt_env_edit_new(CobaltEnvOp op, const char *variable,
+                                   const char *value) {
+  CobaltEnvEdit *edit = g_new0(CobaltEnvEdit, 1);
+  edit->op = op;
+  edit->variable = g_strdup(variable);
+  edit->value = g_strdup(value);
+  return edit;
+}
+
+static gboolean is_valid_variable(const char *variable) {
+  if (*variable == '\0' || g_ascii_isdigit(*variable)) {
+    return FALSE;
+  }
+
+  for (const char *c = variable; *c != '\0'; c++) {
+    if (!g_ascii_isalnum(*c) && *c != '_') {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+CobaltEnvEdit *cobalt_env_edit_parse(const char *key, const char *value, GError **error) {
+  CobaltEnvOp op = COBALT_ENV_OP_SET;
+  g_autofree char *variable = NULL;
+
+  if (g_str_has_prefix(key, UNSET_PREFIX)) {
+    op = COBALT_ENV_OP_UNSET;
+    variable = g_strdup(key + strlen(UNSET_PREFIX));
+  } else if (g_str_has_suffix(key, APPEND_SUFFIX)) {
+    op = COBALT_ENV_OP_APPEND;
+    variable = g_strndup(key, strlen(key) - strlen(APPEND_SUFFIX));
+  } else if (g_str_has_suffix(key, PREPEND_SUFFIX)) {
+    op = COBALT_ENV_OP_PREPEND;
+    variable = g_strndup(key, strlen(key) - strlen(PREPEND_SUFFIX));
+  } else {
+    variable = g_strdup(key);
+  }
+
+  g_strstrip(variable);
+  if (!is_valid_variable(variable)) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "'%s' is not a valid environment variable name", variable);
+    return NULL;
+  }
+
+  if (op == COBALT_ENV_OP_UNSET) {
+    if (value != NULL && *value != '\0') {
+      g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                  "Unsetting '%s' cannot take a value", variable);
+      return NULL;
+    }
+
+    return cobalt_env_edit_new(op, variable, NULL);
+  }
+
+  return cobalt_env_edit_new(op, variable, value != NULL ? value : "");
+}
+
+CobaltEnvEdit *cobalt_env_edit_parse_line(const char *line, GError **error) {
+  const char *equals = strchr(line, '=');
+  if (equals == NULL) {
+    if (g_str_has_prefix(line, UNSET_PREFIX)) {
+      return cobalt_env_edit_parse(line, NULL, error);
+    }
+
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "'%s' is not in the form VARIABLE=VALUE", line);
+    return NULL;
+  }
+
+  g_autofree char *key = g_strndup(line, equals - line);
+  return cobalt_env_edit_parse(key, equals + 1, error);
+}
+
+static char *expand_value(const char *value, const char *arch, const char *app_id) {
+  if (strchr(value, '%') == NULL) {
+    return g_strdup(value);
+  }
+
+  g_autoptr(GString) expanded = g_string_new(value);
+  g_string_replace(expanded, EXPAND_ARCH, arch, 0);
+  g_string_replace(expanded, EXPAND_APP_ID, app_id, 0);
+  return g_string_free(g_steal_pointer(&expanded), FALSE);
+}
+
+void cobalt_env_edit_apply(const CobaltEnvEdit *edit, const char *arch,
+                           const char *app_id) {
+  if (edit->op == COBALT_ENV_OP_UNSET) {
+    g_debug("unsetenv: %s", edit->variable);
+    g_unsetenv(edit->variable);
+    return;
+  }
+
+  g_autofree char *value = expand_value(edit->value, arch, app_id);
+  const char *current = g_getenv(edit->variable);
+  if (current != NULL && *current != '\0') {
+    if (edit->op == COBALT_ENV_OP_APPEND) {
+      g_autofree char *joined = g_strjoin(LIST_SEPARATOR, current, value, NULL);
+      g_free(g_steal_pointer(&value));
+      value = g_steal_pointer(&joined);
+    } else if (edit->op == COBALT_ENV_OP_PREPEND) {
+      g_autofree char *joined = g_strjoin(LIST_SEPARATOR, value, current, NULL);
+      g_free(g_steal_pointer(&value));
+      value = g_steal_pointer(&joined);
+    }
+  }
+
+  g_debug("setenv: %s=%s", edit->variable, value);
+  g_setenv(edit->variable, value, TRUE);
+}
+
+void cobalt_env_edit_free(CobaltEnvEdit *edit) {
+  g_clear_pointer(&edit->variable, g_free);
+  g_clear_pointer(&edit->value, g_free);
+  g_free(edit);
+}
+
+GPtrArray *cobalt_env_read_file(GFile *file, GError **error) {
+  g_autoptr(GPtrArray) edits =
+      g_ptr_array_new_with_free_func((GDestroyNotify)cobalt_env_edit_free);
+
+  g_autoptr(GError) local_error = NULL;
+  g_autofree char *contents = NULL;
+  if (!g_file_load_contents(file, NULL, &contents, NULL, NULL, &local_error)) {
+    if (g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+      g_debug("Environment file '%s' not found", g_file_peek_path(file));
+      return g_steal_pointer(&edits);
+    }
+
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return NULL;
+  }
+
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (char **line = lines; *line != NULL; line++) {
+    g_strstrip(*line);
+    if (**line == '\0' || g_str_has_prefix(*line, "#")) {
+      continue;
+    }
+
+    CobaltEnvEdit *edit = cobalt_env_edit_parse_line(*line, &local_error);
+    if (edit == NULL) {
+      g_warning("Skipping line in '%s': %s", g_file_peek_path(file),
+                local_error->message);
+      g_clear_error(&local_error);
+      continue;
+    }
+
+    g_ptr_array_add(edits, edit);
+  }
+
+  return g_steal_pointer(&edits);
+}
@@ -0,0 +1,52 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+
+typedef enum CobaltEnvOp CobaltEnvOp;
+typedef struct CobaltEnvEdit CobaltEnvEdit;
+
+enum CobaltEnvOp {
+  // NAME=VALUE
+  COBALT_ENV_OP_SET,
+  // NAME+=VALUE, joined to any existing value with a ':'.
+  COBALT_ENV_OP_APPEND,
+  // NAME^=VALUE, joined to any existing value with a ':'.
+  COBALT_ENV_OP_PREPEND,
+  // !NAME
+  COBALT_ENV_OP_UNSET,
+};
+
+struct CobaltEnvEdit {
+  CobaltEnvOp op;
+  char *variable;
+  // NULL for COBALT_ENV_OP_UNSET. May contain %arch% and %app_id%, which are
+  // expanded when the edit is applied.
+  char *value;
+};
+
+CobaltEnvEdit *cobalt_env_edit_new(CobaltEnvOp op, const char *variable,
+                                   const char *value);
+
+// Parses a key and value as found in a key file, i.e. the key includes the
+// operator ("NAME+", "NAME^", "!NAME").
+CobaltEnvEdit *cobalt_env_edit_parse(const char *key, const char *value, GError **error);
+// Parses a single line in the form "NAME=VALUE", "NAME+=VALUE", etc.
+CobaltEnvEdit *cobalt_env_edit_parse_line(const char *line, GError **error);
+
+// Applies the edit to the current process's environment.
+void cobalt_env_edit_apply(const CobaltEnvEdit *edit, const char *arch,
+                           const char *app_id);
+
+void cobalt_env_edit_free(CobaltEnvEdit *edit);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CobaltEnvEdit, cobalt_env_edit_free)
+
+// Reads a file of edits, one per line, into an array of CobaltEnvEdit*. Blank
+// lines, lines starting with '#', and invalid lines (with a warning) are
+// skipped, and a missing file is treated as empty.
+GPtrArray *cobalt_env_read_file(GFile *file, GError **error);
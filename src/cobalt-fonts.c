@@ -0,0 +1,130 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-fonts.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-sched.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FC_CACHE "fc-cache"
+#define FONTCONFIG_CACHE_SUBDIR "fontconfig"
+
+#define STATE_GROUP_FONTS "Fonts"
+#define STATE_FONTS_FINGERPRINT "Fingerprint"
+
+#define HELPER_NICE 19
+
+// The font directories fontconfig scans inside the sandbox. The /run/host ones
+// are the host's fonts, exposed by Flatpak.
+static const char *SYSTEM_FONT_DIRS[] = {
+    "/app/share/fonts",
+    "/usr/share/fonts",
+    "/run/host/fonts",
+    "/run/host/local-fonts",
+    "/run/host/user-fonts",
+    NULL,
+};
+
+// Only the top-level font directories are looked at, since this runs before
+// every launch, and walking the font trees would cost the very startup I/O the
+// warm-up is meant to save. Font packages mostly add or remove whole
+// directories in these, which changes their modification times. Anything deeper
+// down is still picked up by fontconfig itself when the browser starts.
+static void hash_font_dir(GChecksum *checksum, const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return;
+  }
+
+  g_autofree char *entry = g_strdup_printf("%s %" G_GINT64_FORMAT ".%ld\n", path,
+                                           (gint64)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+  g_checksum_update(checksum, (const guchar *)entry, -1);
+}
+
+static char *compute_fonts_fingerprint(CobaltHost *host, GError **error) {
+  g_autoptr(GError) local_error = NULL;
+  const char *runtime_commit = cobalt_host_get_runtime_commit(host, &local_error);
+  if (local_error != NULL) {
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return NULL;
+  }
+
+  g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+  // The runtime's fonts and fontconfig itself may change without any of the
+  // directory times changing, e.g. if the runtime was rebuilt.
+  if (runtime_commit != NULL) {
+    g_checksum_update(checksum, (const guchar *)runtime_commit, -1);
+    g_checksum_update(checksum, (const guchar *)"\n", 1);
+  }
+
+  for (const char **dir = SYSTEM_FONT_DIRS; *dir != NULL; dir++) {
+    g_autofree char *path = cobalt_util_get_root_path(*dir);
+    hash_font_dir(checksum, path);
+  }
+
+  g_autofree char *user_font_dir = g_build_filename(g_get_user_data_dir(), "fonts", NULL);
+  hash_font_dir(checksum, user_font_dir);
+
+  return g_strdup(g_checksum_get_string(checksum));
+}
+
+gboolean cobalt_fonts_warm_up(CobaltHost *host, CobaltState *state, GError **error) {
+  g_autofree char *fingerprint = compute_fonts_fingerprint(host, error);
+  if (fingerprint == NULL) {
+    g_prefix_error(error, "Failed to fingerprint font directories: ");
+    return FALSE;
+  }
+
+  g_autofree char *cache_dir =
+      g_build_filename(g_get_user_cache_dir(), FONTCONFIG_CACHE_SUBDIR, NULL);
+  g_autofree char *last_fingerprint =
+      cobalt_state_get_string(state, STATE_GROUP_FONTS, STATE_FONTS_FINGERPRINT);
+
+  if (g_strcmp0(fingerprint, last_fingerprint) == 0 &&
+      g_file_test(cache_dir, G_FILE_TEST_IS_DIR)) {
+    return TRUE;
+  }
+
+  g_autofree char *fc_cache = g_find_program_in_path(FC_CACHE);
+  if (fc_cache == NULL) {
+    g_debug("%s is not available, not warming up the font caches", FC_CACHE);
+    return TRUE;
+  }
+
+  g_debug("Font caches are missing or out of date, rebuilding them in the background");
+  if (!cobalt_helper_spawn(COBALT_FONTS_HELPER_WARM_UP, error, fc_cache, NULL)) {
+    return FALSE;
+  }
+
+  // Recorded right away rather than once the helper is done, so an interrupted
+  // rebuild isn't retried on every launch; fontconfig will finish the job itself
+  // the next time it notices a stale cache.
+  cobalt_state_set_string(state, STATE_GROUP_FONTS, STATE_FONTS_FINGERPRINT,
+                          fingerprint);
+  return TRUE;
+}
+
+int cobalt_fonts_helper_warm_up(int argc, char **argv) {
+  if (argc != 1) {
+    g_printerr("usage: " COBALT_FONTS_HELPER_WARM_UP " FC-CACHE\n");
+    return 1;
+  }
+
+  setpriority(PRIO_PROCESS, 0, HELPER_NICE);
+  cobalt_sched_set_io_priority(0, COBALT_SCHED_IO_CLASS_IDLE, 0, NULL);
+
+  char *fc_cache_argv[] = {argv[0], NULL};
+  execv(argv[0], fc_cache_argv);
+
+  int saved_errno = errno;
+  g_printerr("Failed to exec %s: %s\n", argv[0], g_strerror(saved_errno));
+  return 1;
+}
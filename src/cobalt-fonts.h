@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-host.h"
+#include "cobalt-state.h"
+
+#include <glib.h>
+
+#define COBALT_FONTS_HELPER_WARM_UP "fontconfig-warm-up"
+
+// Starts rebuilding the fontconfig caches in the background if they're missing
+// or the font directories changed since the last launch, so the browser won't
+// have to do it while starting up.
+gboolean cobalt_fonts_warm_up(CobaltHost *host, CobaltState *state, GError **error);
+
+int cobalt_fonts_helper_warm_up(int argc, char **argv);
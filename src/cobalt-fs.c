@@ -0,0 +1,211 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-fs.h"
+
+#include "cobalt-profile.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <linux/fs.h>
+#include <linux/magic.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#define STATE_GROUP_FILESYSTEM "Filesystem"
+#define STATE_FILESYSTEM_PROFILE_PATH "ProfilePath"
+#define STATE_FILESYSTEM_PROFILE_TYPE "ProfileType"
+
+typedef struct FsTypeInfo {
+  CobaltFsType type;
+  const char *name;
+} FsTypeInfo;
+
+// Indexed by CobaltFsType.
+static const FsTypeInfo FS_TYPES[] = {
+    {COBALT_FS_TYPE_OTHER, "other"},     {COBALT_FS_TYPE_BTRFS, "btrfs"},
+    {COBALT_FS_TYPE_NFS, "nfs"},         {COBALT_FS_TYPE_CIFS, "cifs"},
+    {COBALT_FS_TYPE_OVERLAY, "overlay"}, {COBALT_FS_TYPE_FUSE, "fuse"},
+};
+
+const char *cobalt_fs_type_to_string(CobaltFsType type) {
+  g_return_val_if_fail(type < G_N_ELEMENTS(FS_TYPES), NULL);
+  return FS_TYPES[type].name;
+}
+
+static gboolean parse_fs_type(const char *string, CobaltFsType *type) {
+  for (gsize i = 0; i < G_N_ELEMENTS(FS_TYPES); i++) {
+    if (g_str_equal(string, FS_TYPES[i].name)) {
+      *type = FS_TYPES[i].type;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+gboolean cobalt_fs_type_is_network(CobaltFsType type) {
+  return type == COBALT_FS_TYPE_NFS || type == COBALT_FS_TYPE_CIFS;
+}
+
+static CobaltFsType fs_type_from_magic(unsigned long magic) {
+  switch (magic) {
+  case BTRFS_SUPER_MAGIC:
+    return COBALT_FS_TYPE_BTRFS;
+  case NFS_SUPER_MAGIC:
+    return COBALT_FS_TYPE_NFS;
+  case SMB_SUPER_MAGIC:
+  case CIFS_SUPER_MAGIC:
+  case SMB2_SUPER_MAGIC:
+    return COBALT_FS_TYPE_CIFS;
+  case OVERLAYFS_SUPER_MAGIC:
+    return COBALT_FS_TYPE_OVERLAY;
+  case FUSE_SUPER_MAGIC:
+    return COBALT_FS_TYPE_FUSE;
+  default:
+    return COBALT_FS_TYPE_OTHER;
+  }
+}
+
+gboolean cobalt_fs_detect(const char *path, CobaltFsType *type, GError **error) {
+  g_autofree char *current = g_strdup(path);
+  for (;;) {
+    struct statfs st;
+    if (statfs(current, &st) == 0) {
+      *type = fs_type_from_magic(st.f_type);
+      return TRUE;
+    }
+
+    if (errno != ENOENT) {
+      return cobalt_util_set_error_from_errno(error, "get filesystem of", current);
+    }
+
+    g_autofree char *parent = g_path_get_dirname(current);
+    if (g_str_equal(parent, current)) {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "'%s' does not exist", path);
+      return FALSE;
+    }
+
+    g_free(current);
+    current = g_steal_pointer(&parent);
+  }
+}
+
+// Files created in the directory afterwards inherit the attribute, but existing
+// ones can't lose copy-on-write anymore once they have any data.
+static gboolean set_nocow(const char *path, GError **error) {
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    return cobalt_util_set_error_from_errno(error, "open", path);
+  }
+
+  int flags = 0;
+  if (ioctl(fd, FS_IOC_GETFLAGS, &flags) == -1) {
+    cobalt_util_set_error_from_errno(error, "get attributes of", path);
+    close(fd);
+    return FALSE;
+  }
+
+  if (!(flags & FS_NOCOW_FL)) {
+    flags |= FS_NOCOW_FL;
+    if (ioctl(fd, FS_IOC_SETFLAGS, &flags) == -1) {
+      cobalt_util_set_error_from_errno(error, "disable copy-on-write for", path);
+      close(fd);
+      return FALSE;
+    }
+
+    g_debug("Disabled copy-on-write for '%s'", path);
+  }
+
+  close(fd);
+  return TRUE;
+}
+
+// The SQLite databases and the in-profile caches all live in the individual
+// profiles, which the browser creates inside profile_dir. A fresh profile
+// directory is created here, so everything the browser puts into it later
+// inherits the attribute.
+static gboolean disable_profile_cow(const char *profile_dir, GError **error) {
+  if (g_mkdir_with_parents(profile_dir, 0700) == -1) {
+    return cobalt_util_set_error_from_errno(error, "create", profile_dir);
+  }
+
+  if (!set_nocow(profile_dir, error)) {
+    return FALSE;
+  }
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    if (!set_nocow(profiles->pdata[i], error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean get_profile_fs_type(CobaltState *state, const char *profile_dir,
+                                    CobaltFsType *type, GError **error) {
+  g_autofree char *cached_path = cobalt_state_get_string(
+      state, STATE_GROUP_FILESYSTEM, STATE_FILESYSTEM_PROFILE_PATH);
+  g_autofree char *cached_type = cobalt_state_get_string(
+      state, STATE_GROUP_FILESYSTEM, STATE_FILESYSTEM_PROFILE_TYPE);
+  if (g_strcmp0(cached_path, profile_dir) == 0 && cached_type != NULL &&
+      parse_fs_type(cached_type, type)) {
+    return TRUE;
+  }
+
+  if (!cobalt_fs_detect(profile_dir, type, error)) {
+    return FALSE;
+  }
+
+  g_debug("Profile '%s' is on a filesystem of type '%s'", profile_dir,
+          cobalt_fs_type_to_string(*type));
+
+  cobalt_state_set_string(state, STATE_GROUP_FILESYSTEM, STATE_FILESYSTEM_PROFILE_PATH,
+                          profile_dir);
+  cobalt_state_set_string(state, STATE_GROUP_FILESYSTEM, STATE_FILESYSTEM_PROFILE_TYPE,
+                          cobalt_fs_type_to_string(*type));
+  return TRUE;
+}
+
+// XDG_CACHE_HOME usually shares the network home directory with the profile,
+// in which case only the tmpfs under XDG_RUNTIME_DIR is left.
+static CobaltConfigCacheLocation pick_local_cache_location(void) {
+  CobaltFsType cache_type = COBALT_FS_TYPE_OTHER;
+  g_autoptr(GError) error = NULL;
+  if (!cobalt_fs_detect(g_get_user_cache_dir(), &cache_type, &error)) {
+    g_warning("Failed to get filesystem of the cache directory: %s", error->message);
+    return COBALT_CONFIG_CACHE_LOCATION_RUNTIME;
+  }
+
+  return cobalt_fs_type_is_network(cache_type) ? COBALT_CONFIG_CACHE_LOCATION_RUNTIME
+                                               : COBALT_CONFIG_CACHE_LOCATION_CACHE;
+}
+
+gboolean cobalt_fs_tune_profile(CobaltConfig *config, CobaltState *state,
+                                const char *profile_dir, GError **error) {
+  CobaltFsType type = COBALT_FS_TYPE_OTHER;
+  if (!get_profile_fs_type(state, profile_dir, &type, error)) {
+    return FALSE;
+  }
+
+  if (type == COBALT_FS_TYPE_BTRFS && config->filesystem.no_cow) {
+    return disable_profile_cow(profile_dir, error);
+  }
+
+  if (cobalt_fs_type_is_network(type) && config->filesystem.local_caches &&
+      config->cache.location == COBALT_CONFIG_CACHE_LOCATION_PROFILE) {
+    config->cache.location = pick_local_cache_location();
+    g_debug("Profile is on a network filesystem, moving caches to %s",
+            config->cache.location == COBALT_CONFIG_CACHE_LOCATION_CACHE
+                ? "XDG_CACHE_HOME"
+                : "XDG_RUNTIME_DIR");
+  }
+
+  return TRUE;
+}
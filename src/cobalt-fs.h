@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+#include "cobalt-state.h"
+
+#include <glib.h>
+
+typedef enum {
+  COBALT_FS_TYPE_OTHER,
+  COBALT_FS_TYPE_BTRFS,
+  COBALT_FS_TYPE_NFS,
+  COBALT_FS_TYPE_CIFS,
+  COBALT_FS_TYPE_OVERLAY,
+  COBALT_FS_TYPE_FUSE,
+} CobaltFsType;
+
+const char *cobalt_fs_type_to_string(CobaltFsType type);
+
+gboolean cobalt_fs_type_is_network(CobaltFsType type);
+
+// Detects the type of the filesystem path is on. If path doesn't exist yet, its
+// closest existing parent is checked instead.
+gboolean cobalt_fs_detect(const char *path, CobaltFsType *type, GError **error);
+
+// Tunes the browser for the filesystem its profile at profile_dir is on, as
+// configured by [Filesystem]. The type is only detected once per profile path,
+// and then remembered in the state. This may change config->cache.location, so
+// it must be called before the caches are set up.
+gboolean cobalt_fs_tune_profile(CobaltConfig *config, CobaltState *state,
+                                const char *profile_dir, GError **error);
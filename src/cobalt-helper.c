@@ -0,0 +1,117 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-helper.h"
+
+#include "cobalt-cache.h"
+#include "cobalt-fonts.h"
+#include "cobalt-maintenance.h"
+#include "cobalt-profile-ram.h"
+#include "cobalt-sched.h"
+#include "cobalt-watchdog.h"
+
+#include <unistd.h>
+
+#define HELPER_ARG_PREFIX "--cobalt-helper="
+#define SELF_EXE_PATH "/proc/self/exe"
+
+typedef int (*CobaltHelperFunc)(int argc, char **argv);
+
+static const struct {
+  const char *name;
+  CobaltHelperFunc func;
+} HELPERS[] = {
+    {COBALT_SCHED_HELPER_RESTORE_IO_PRIORITY, cobalt_sched_helper_restore_io_priority},
+    {COBALT_PROFILE_RAM_HELPER_SYNC, cobalt_profile_ram_helper_sync},
+    {COBALT_CACHE_HELPER_REMOVE_STALE, cobalt_cache_helper_remove_stale},
+    {COBALT_FONTS_HELPER_WARM_UP, cobalt_fonts_helper_warm_up},
+    {COBALT_MAINTENANCE_HELPER_RUN, cobalt_maintenance_helper_run},
+    {COBALT_WATCHDOG_HELPER_RUN, cobalt_watchdog_helper_run},
+};
+
+static void helper_child_setup(gpointer user_data) {
+  // Keep the helper out of the browser's session, so e.g. a Ctrl-C in the
+  // terminal won't take it down mid-task.
+  setsid();
+}
+
+static gboolean spawn_helper(const char *helper, int fd, const char *const *args,
+                             GError **error) {
+  g_autoptr(GPtrArray) argv = g_ptr_array_new_with_free_func(g_free);
+  g_ptr_array_add(argv, g_strdup(SELF_EXE_PATH));
+  g_ptr_array_add(argv, g_strdup_printf(HELPER_ARG_PREFIX "%s", helper));
+
+  for (; args && *args != NULL; args++) {
+    g_ptr_array_add(argv, g_strdup(*args));
+  }
+
+  g_ptr_array_add(argv, NULL);
+
+  int source_fds[] = {fd};
+  int target_fds[] = {COBALT_HELPER_INHERITED_FD};
+
+  // Without G_SPAWN_DO_NOT_REAP_CHILD, GLib double-forks, so the helper is
+  // reparented away from the process that is about to become the browser.
+  if (!g_spawn_async_with_pipes_and_fds(
+          NULL, (const char *const *)argv->pdata, NULL, G_SPAWN_DEFAULT,
+          helper_child_setup, NULL, -1, -1, -1, fd != -1 ? source_fds : NULL,
+          fd != -1 ? target_fds : NULL, fd != -1 ? 1 : 0, NULL, NULL, NULL, NULL,
+          error)) {
+    g_prefix_error(error, "Failed to spawn helper '%s': ", helper);
+    return FALSE;
+  }
+
+  g_debug("Spawned helper '%s'", helper);
+  return TRUE;
+}
+
+static GPtrArray *collect_args(va_list va) {
+  GPtrArray *args = g_ptr_array_new();
+  for (const char *arg = va_arg(va, const char *); arg != NULL;
+       arg = va_arg(va, const char *)) {
+    g_ptr_array_add(args, (gpointer)arg);
+  }
+
+  g_ptr_array_add(args, NULL);
+  return args;
+}
+
+gboolean cobalt_helper_spawn(const char *helper, GError **error, ...) {
+  va_list va;
+  va_start(va, error);
+  g_autoptr(GPtrArray) args = collect_args(va);
+  va_end(va);
+  return spawn_helper(helper, -1, (const char *const *)args->pdata, error);
+}
+
+gboolean cobalt_helper_spawn_with_fd(const char *helper, int fd, GError **error, ...) {
+  va_list va;
+  va_start(va, error);
+  g_autoptr(GPtrArray) args = collect_args(va);
+  va_end(va);
+  return spawn_helper(helper, fd, (const char *const *)args->pdata, error);
+}
+
+gboolean cobalt_helper_spawnv(const char *helper, const char *const *args,
+                              GError **error) {
+  return spawn_helper(helper, -1, args, error);
+}
+
+gboolean cobalt_helper_is_invocation(int argc, char **argv) {
+  return argc > 1 && g_str_has_prefix(argv[1], HELPER_ARG_PREFIX);
+}
+
+int cobalt_helper_run(int argc, char **argv) {
+  g_return_val_if_fail(cobalt_helper_is_invocation(argc, argv), 1);
+
+  const char *name = argv[1] + strlen(HELPER_ARG_PREFIX);
+  for (gsize i = 0; i < G_N_ELEMENTS(HELPERS); i++) {
+    if (g_str_equal(HELPERS[i].name, name)) {
+      return HELPERS[i].func(argc - 2, argv + 2);
+    }
+  }
+
+  g_printerr("Unknown helper: %s\n", name);
+  return 1;
+}
@@ -0,0 +1,26 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+// Helpers are small background tasks that need to outlive cobalt's exec() into
+// the browser. They are run by re-executing cobalt itself in a detached
+// process, so they never share state with the threads GLib started in the
+// parent.
+
+// The file descriptor number that cobalt_helper_spawn_with_fd's fd is given in
+// the helper.
+#define COBALT_HELPER_INHERITED_FD 3
+
+gboolean cobalt_helper_spawn(const char *helper, GError **error,
+                             ...) G_GNUC_NULL_TERMINATED;
+gboolean cobalt_helper_spawn_with_fd(const char *helper, int fd, GError **error,
+                                     ...) G_GNUC_NULL_TERMINATED;
+gboolean cobalt_helper_spawnv(const char *helper, const char *const *args,
+                              GError **error);
+
+gboolean cobalt_helper_is_invocation(int argc, char **argv);
+int cobalt_helper_run(int argc, char **argv);
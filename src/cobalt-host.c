@@ -4,8 +4,11 @@
 
 #include "cobalt-host.h"
 
+#include "cobalt-util.h"
+
 #include <errno.h>
 #include <gio/gdesktopappinfo.h>
+#include <sys/utsname.h>
 
 #define FLATPAK_INFO_PATH "/.flatpak-info"
 
@@ -14,6 +17,8 @@
 
 #define FLATPAK_INFO_INSTANCE "Instance"
 #define FLATPAK_INFO_INSTANCE_FP_VERSION "flatpak-version"
+#define FLATPAK_INFO_INSTANCE_RUNTIME_COMMIT "runtime-commit"
+#define FLATPAK_INFO_INSTANCE_RUNTIME_EXTENSIONS "runtime-extensions"
 
 #define FLEXTOP_INIT_PATH "/app/bin/flextop-init"
 #define ZYPAK_WRAPPER_PATH "/app/bin/zypak-wrapper.sh"
@@ -54,8 +59,12 @@ typedef struct FlatpakPortal {
 } FlatpakPortal;
 
 struct CobaltHost {
+  GKeyFile *flatpak_info;
   char *app_id;
   char *exec;
+  char *machine;
+  char *runtime_commit;
+  char *runtime_extensions;
   SemVer *fp_version;
   FlatpakPortal portal;
   int flags;
@@ -107,10 +116,24 @@ CobaltHost *cobalt_host_new(GError **error) {
   return host;
 }
 
+static GKeyFile *cobalt_host_get_flatpak_info(CobaltHost *host, GError **error) {
+  if (!host->flatpak_info) {
+    g_autofree char *path = cobalt_util_get_root_path(FLATPAK_INFO_PATH);
+    g_autoptr(GKeyFile) key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, error)) {
+      return NULL;
+    }
+
+    host->flatpak_info = g_steal_pointer(&key_file);
+  }
+
+  return host->flatpak_info;
+}
+
 const char *cobalt_host_get_app_id(CobaltHost *host, GError **error) {
   if (!host->app_id) {
-    g_autoptr(GKeyFile) key_file = g_key_file_new();
-    if (!g_key_file_load_from_file(key_file, FLATPAK_INFO_PATH, G_KEY_FILE_NONE, error)) {
+    GKeyFile *key_file = cobalt_host_get_flatpak_info(host, error);
+    if (key_file == NULL) {
       return NULL;
     }
 
@@ -147,10 +170,59 @@ const char *cobalt_host_get_app_exec(CobaltHost *host, GError **error) {
   return host->exec;
 }
 
+const char *cobalt_host_get_machine(CobaltHost *host, GError **error) {
+  if (!host->machine) {
+    struct utsname utsname;
+    if (uname(&utsname) == -1) {
+      int saved_errno = errno;
+      g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                  "Failed to get utsname: %s", g_strerror(saved_errno));
+      return NULL;
+    }
+
+    host->machine = g_strdup(utsname.machine);
+  }
+
+  return host->machine;
+}
+
+static gboolean get_optional_instance_value(CobaltHost *host, const char *key,
+                                            char **value, GError **error) {
+  if (*value == NULL) {
+    GKeyFile *key_file = cobalt_host_get_flatpak_info(host, error);
+    if (key_file == NULL) {
+      g_prefix_error(error, "Loading Flatpak info: ");
+      return FALSE;
+    }
+
+    *value = g_key_file_get_string(key_file, FLATPAK_INFO_INSTANCE, key, NULL);
+  }
+
+  return TRUE;
+}
+
+const char *cobalt_host_get_runtime_commit(CobaltHost *host, GError **error) {
+  if (!get_optional_instance_value(host, FLATPAK_INFO_INSTANCE_RUNTIME_COMMIT,
+                                   &host->runtime_commit, error)) {
+    return NULL;
+  }
+
+  return host->runtime_commit;
+}
+
+const char *cobalt_host_get_runtime_extensions(CobaltHost *host, GError **error) {
+  if (!get_optional_instance_value(host, FLATPAK_INFO_INSTANCE_RUNTIME_EXTENSIONS,
+                                   &host->runtime_extensions, error)) {
+    return NULL;
+  }
+
+  return host->runtime_extensions;
+}
+
 static SemVer *cobalt_host_get_fp_version(CobaltHost *host, GError **error) {
   if (!host->fp_version) {
-    g_autoptr(GKeyFile) key_file = g_key_file_new();
-    if (!g_key_file_load_from_file(key_file, FLATPAK_INFO_PATH, G_KEY_FILE_NONE, error)) {
+    GKeyFile *key_file = cobalt_host_get_flatpak_info(host, error);
+    if (key_file == NULL) {
       g_prefix_error(error, "Loading Flatpak info: ");
       return NULL;
     }
@@ -219,13 +291,14 @@ void cobalt_host_get_expose_pids_available(CobaltHost *host, gboolean *available
   *available = host->flags & FLAG_EXPOSE_PIDS_AVAILABLE;
 }
 
-static gboolean check_for_binary(const char *path, gboolean *available, GError **error) {
+static gboolean check_for_binary(const char *sandbox_path, gboolean *available,
+                                 GError **error) {
+  g_autofree char *path = cobalt_util_get_root_path(sandbox_path);
   gboolean local_available = access(path, F_OK | X_OK) != -1;
   if (!local_available && errno != ENOENT && errno != EPERM) {
     int saved_errno = errno;
     g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
-                "Failed to check " ZYPAK_WRAPPER_PATH " existence: %s",
-                g_strerror(saved_errno));
+                "Failed to check %s existence: %s", path, g_strerror(saved_errno));
     return FALSE;
   }
 
@@ -299,8 +372,12 @@ gboolean cobalt_host_get_slash_tmp_shared_available(CobaltHost *host, gboolean *
 }
 
 void cobalt_host_free(CobaltHost *host) {
+  g_clear_pointer(&host->flatpak_info, g_key_file_unref);
   g_clear_pointer(&host->app_id, g_free);
   g_clear_pointer(&host->exec, g_free);
+  g_clear_pointer(&host->machine, g_free);
+  g_clear_pointer(&host->runtime_commit, g_free);
+  g_clear_pointer(&host->runtime_extensions, g_free);
   g_clear_pointer(&host->fp_version, g_free);
   g_free(host);
 }
@@ -15,6 +15,14 @@ const char *cobalt_host_get_app_id(CobaltHost *host, GError **error);
 
 const char *cobalt_host_get_app_exec(CobaltHost *host, GError **error);
 
+// The machine name from uname, e.g. "x86_64".
+const char *cobalt_host_get_machine(CobaltHost *host, GError **error);
+
+// Both of these may return NULL without setting an error if the value is not
+// present in the Flatpak info file.
+const char *cobalt_host_get_runtime_commit(CobaltHost *host, GError **error);
+const char *cobalt_host_get_runtime_extensions(CobaltHost *host, GError **error);
+
 void cobalt_host_get_expose_pids_available(CobaltHost *host, gboolean *available);
 
 gboolean cobalt_host_get_flextop_available(CobaltHost *host, gboolean *available,
@@ -0,0 +1,20 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-launcher.h"
+
+// Internals of CobaltLauncher, only exposed so they can be benchmarked.
+
+void cobalt_launcher_set_features_from_flag_value(CobaltLauncher *launcher,
+                                                  const char *value,
+                                                  CobaltLauncherFeatureStatus status);
+
+char *cobalt_launcher_format_features_as_flag(CobaltLauncher *launcher,
+                                              CobaltLauncherFeatureStatus status);
+
+// Builds the NULL-terminated argv to exec. This moves the entry point and
+// arguments out of the launcher, so it can only be called once.
+GPtrArray *cobalt_launcher_build_argv(CobaltLauncher *launcher);
@@ -5,9 +5,9 @@
 #include "cobalt-launcher.h"
 
 #include "cobalt-host.h"
+#include "cobalt-launcher-private.h"
 
 #include <errno.h>
-#include <sys/utsname.h>
 
 #define FLAG_PREFIX "--"
 
@@ -30,9 +30,20 @@ struct CobaltLauncher {
 
   GHashTable *feature_statuses;
 
+  // Applied on top of the environment set up by the launcher itself.
+  GPtrArray *env_edits;
+
   gboolean use_zypak;
   char *sandbox_filename;
   char *expose_widevine_path;
+
+  CobaltSchedPolicy sched_policy;
+
+  gboolean has_affinity;
+  CobaltAffinity affinity;
+
+  // Set by cobalt_launcher_prepare.
+  GPtrArray *argv;
 };
 
 CobaltLauncher *cobalt_launcher_new(CobaltHost *host, const char *entry_point,
@@ -44,6 +55,8 @@ CobaltLauncher *cobalt_launcher_new(CobaltHost *host, const char *entry_point,
   launcher->wrapper_script = g_strdup(wrapper_script);
   launcher->feature_statuses =
       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  launcher->env_edits =
+      g_ptr_array_new_with_free_func((GDestroyNotify)cobalt_env_edit_free);
   return launcher;
 }
 
@@ -67,6 +80,17 @@ void cobalt_launcher_zypak_expose_widevine_path(CobaltLauncher *launcher,
   launcher->expose_widevine_path = g_strdup(widevine_path);
 }
 
+void cobalt_launcher_set_sched_policy(CobaltLauncher *launcher,
+                                      const CobaltSchedPolicy *policy) {
+  launcher->sched_policy = *policy;
+}
+
+void cobalt_launcher_set_affinity(CobaltLauncher *launcher,
+                                  const CobaltAffinity *affinity) {
+  launcher->has_affinity = TRUE;
+  launcher->affinity = *affinity;
+}
+
 void cobalt_launcher_set_feature(CobaltLauncher *launcher, const char *feature,
                                  CobaltLauncherFeatureStatus status) {
   g_hash_table_replace(launcher->feature_statuses, g_strdup(feature),
@@ -153,6 +177,23 @@ gboolean cobalt_launcher_read_flags_file(CobaltLauncher *launcher, GFile *file,
   return TRUE;
 }
 
+void cobalt_launcher_setenv(CobaltLauncher *launcher, const char *variable,
+                            const char *value) {
+  g_ptr_array_add(launcher->env_edits,
+                  cobalt_env_edit_new(COBALT_ENV_OP_SET, variable, value));
+}
+
+void cobalt_launcher_add_env_edit(CobaltLauncher *launcher, const CobaltEnvEdit *edit) {
+  g_ptr_array_add(launcher->env_edits,
+                  cobalt_env_edit_new(edit->op, edit->variable, edit->value));
+}
+
+void cobalt_launcher_add_env_edits(CobaltLauncher *launcher, GPtrArray *edits) {
+  for (guint i = 0; edits != NULL && i < edits->len; i++) {
+    cobalt_launcher_add_env_edit(launcher, g_ptr_array_index(edits, i));
+  }
+}
+
 void cobalt_launcher_add_arg(CobaltLauncher *launcher, const char *arg) {
   g_return_if_fail(arg != NULL);
 
@@ -173,8 +214,9 @@ void cobalt_launcher_add_argv(CobaltLauncher *launcher, char **argv) {
   }
 }
 
-static void set_features_from_flag_value(CobaltLauncher *launcher, const char *value,
-                                         CobaltLauncherFeatureStatus status) {
+void cobalt_launcher_set_features_from_flag_value(CobaltLauncher *launcher,
+                                                  const char *value,
+                                                  CobaltLauncherFeatureStatus status) {
   g_auto(GStrv) features = g_strsplit(value, ",", -1);
   for (char **feature = features; feature && *feature != NULL; feature++) {
     if (**feature == '\0') {
@@ -185,8 +227,8 @@ static void set_features_from_flag_value(CobaltLauncher *launcher, const char *v
   }
 }
 
-static char *format_features_as_flag(CobaltLauncher *launcher,
-                                     CobaltLauncherFeatureStatus status) {
+char *cobalt_launcher_format_features_as_flag(CobaltLauncher *launcher,
+                                              CobaltLauncherFeatureStatus status) {
   g_autoptr(GPtrArray) features = g_ptr_array_new();
 
   GHashTableIter iter;
@@ -220,7 +262,7 @@ static char *format_features_as_flag(CobaltLauncher *launcher,
   }
 }
 
-static GPtrArray *launcher_build_argv(CobaltLauncher *launcher) {
+GPtrArray *cobalt_launcher_build_argv(CobaltLauncher *launcher) {
   g_autoptr(GPtrArray) argv = g_ptr_array_new_with_free_func(g_free);
   if (launcher->use_zypak) {
     g_ptr_array_add(argv, g_strdup("zypak-wrapper.sh"));
@@ -228,13 +270,13 @@ static GPtrArray *launcher_build_argv(CobaltLauncher *launcher) {
   g_ptr_array_add(argv, g_steal_pointer(&launcher->entry_point));
 
   g_autofree char *enabled_features_flag =
-      format_features_as_flag(launcher, COBALT_LAUNCHER_FEATURE_ENABLED);
+      cobalt_launcher_format_features_as_flag(launcher, COBALT_LAUNCHER_FEATURE_ENABLED);
   if (enabled_features_flag != NULL) {
     g_ptr_array_add(argv, g_steal_pointer(&enabled_features_flag));
   }
 
   g_autofree char *disabled_features_flag =
-      format_features_as_flag(launcher, COBALT_LAUNCHER_FEATURE_DISABLED);
+      cobalt_launcher_format_features_as_flag(launcher, COBALT_LAUNCHER_FEATURE_DISABLED);
   if (disabled_features_flag != NULL) {
     g_ptr_array_add(argv, g_steal_pointer(&disabled_features_flag));
   }
@@ -270,20 +312,17 @@ static gboolean launcher_update_environment(CobaltLauncher *launcher, GError **e
     launcher_setenv("TMPDIR", "/var/tmp");
   }
 
-  struct utsname utsname;
-  if (uname(&utsname) == -1) {
-    int saved_errno = errno;
-    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
-                "Failed to get utsname: %s", g_strerror(saved_errno));
+  const char *machine = cobalt_host_get_machine(launcher->host, error);
+  if (machine == NULL) {
     return FALSE;
   }
 
   g_autofree char *libgl_drivers_path =
-      g_strdup_printf("/usr/lib/%s-linux-gnu/GL/lib/dri", utsname.machine);
+      g_strdup_printf("/usr/lib/%s-linux-gnu/GL/lib/dri", machine);
   launcher_setenv("LIBGL_DRIVERS_PATH", libgl_drivers_path);
 
   g_autofree char *vk_driver_files =
-      g_strdup_printf("/usr/lib/%s-linux-gnu/GL/vulkan/icd.d", utsname.machine);
+      g_strdup_printf("/usr/lib/%s-linux-gnu/GL/vulkan/icd.d", machine);
   launcher_setenv("VK_DRIVER_FILES", vk_driver_files);
 
   launcher_setenv(
@@ -294,7 +333,9 @@ static gboolean launcher_update_environment(CobaltLauncher *launcher, GError **e
   g_autofree char *chrome_desktop = g_strdup_printf("%s.desktop", app_id);
   launcher_setenv("CHROME_DESKTOP", chrome_desktop);
 
-  launcher_setenv("CHROME_WRAPPER", launcher->wrapper_script);
+  if (launcher->wrapper_script != NULL) {
+    launcher_setenv("CHROME_WRAPPER", launcher->wrapper_script);
+  }
 
   if (launcher->sandbox_filename != NULL) {
     launcher_setenv("ZYPAK_SANDBOX_FILENAME", launcher->sandbox_filename);
@@ -305,36 +346,82 @@ static gboolean launcher_update_environment(CobaltLauncher *launcher, GError **e
 
   launcher_setenv("ZYPAK_SPAWN_LATEST_ON_REEXEC", "1");
 
+  for (guint i = 0; i < launcher->env_edits->len; i++) {
+    cobalt_env_edit_apply(g_ptr_array_index(launcher->env_edits, i), machine, app_id);
+  }
+
   return TRUE;
 }
 
-void cobalt_launcher_exec(CobaltLauncher *launcher, GError **error) {
+gboolean cobalt_launcher_prepare(CobaltLauncher *launcher, GError **error) {
+  g_return_val_if_fail(launcher->argv == NULL, FALSE);
+
   if (launcher->enable_features) {
-    set_features_from_flag_value(launcher, launcher->enable_features,
-                                 COBALT_LAUNCHER_FEATURE_ENABLED);
+    cobalt_launcher_set_features_from_flag_value(launcher, launcher->enable_features,
+                                                 COBALT_LAUNCHER_FEATURE_ENABLED);
   }
 
   if (launcher->disable_features) {
-    set_features_from_flag_value(launcher, launcher->disable_features,
-                                 COBALT_LAUNCHER_FEATURE_DISABLED);
+    cobalt_launcher_set_features_from_flag_value(launcher, launcher->disable_features,
+                                                 COBALT_LAUNCHER_FEATURE_DISABLED);
   }
 
   if (!launcher_update_environment(launcher, error)) {
-    return;
+    return FALSE;
+  }
+
+  launcher->argv = cobalt_launcher_build_argv(launcher);
+  for (int i = 0; i < launcher->argv->len - 1; i++) {
+    g_debug("Arg: '%s'", (char *)g_ptr_array_index(launcher->argv, i));
   }
 
-  g_autoptr(GPtrArray) argv = launcher_build_argv(launcher);
-  for (int i = 0; i < argv->len - 1; i++) {
-    g_debug("Arg: '%s'", (char *)g_ptr_array_index(argv, i));
+  // Everything set here is inherited by the entire browser process tree.
+  cobalt_sched_apply(&launcher->sched_policy);
+  if (launcher->has_affinity) {
+    cobalt_affinity_apply(&launcher->affinity);
   }
 
-  execvp(g_ptr_array_index(argv, 0), (char *const *)argv->pdata);
+  return TRUE;
+}
+
+void cobalt_launcher_exec(CobaltLauncher *launcher, GError **error) {
+  if (launcher->argv == NULL && !cobalt_launcher_prepare(launcher, error)) {
+    return;
+  }
+
+  execvp(g_ptr_array_index(launcher->argv, 0), (char *const *)launcher->argv->pdata);
 
   int saved_errno = errno;
   g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno), "Failed to exec: %s",
               g_strerror(saved_errno));
 }
 
+GPid cobalt_launcher_spawn(CobaltLauncher *launcher, const char *const *extra_args,
+                           GError **error) {
+  g_return_val_if_fail(launcher->argv != NULL, 0);
+
+  // The prepared argv is left untouched, so it can be reused for the next spawn.
+  g_autoptr(GPtrArray) argv = g_ptr_array_new();
+  for (guint i = 0; i < launcher->argv->len - 1; i++) {
+    g_ptr_array_add(argv, g_ptr_array_index(launcher->argv, i));
+  }
+  for (; extra_args && *extra_args != NULL; extra_args++) {
+    g_ptr_array_add(argv, (gpointer)*extra_args);
+  }
+  g_ptr_array_add(argv, NULL);
+
+  GPid pid = 0;
+  if (!g_spawn_async(NULL, (char **)argv->pdata, NULL,
+                     G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                         G_SPAWN_CHILD_INHERITS_STDIN,
+                     NULL, NULL, &pid, error)) {
+    g_prefix_error(error, "Failed to spawn browser: ");
+    return 0;
+  }
+
+  return pid;
+}
+
 void cobalt_launcher_free(CobaltLauncher *launcher) {
   g_clear_pointer(&launcher->entry_point, g_free);
   g_clear_pointer(&launcher->args, g_ptr_array_unref);  // NOLINT
@@ -345,7 +432,12 @@ void cobalt_launcher_free(CobaltLauncher *launcher) {
   g_clear_pointer(&launcher->disable_features, g_free);
 
   g_clear_pointer(&launcher->feature_statuses, g_hash_table_unref);  // NOLINT
+  g_clear_pointer(&launcher->env_edits, g_ptr_array_unref);          // NOLINT
 
   g_clear_pointer(&launcher->sandbox_filename, g_free);
   g_clear_pointer(&launcher->expose_widevine_path, g_free);
+
+  g_clear_pointer(&launcher->argv, g_ptr_array_unref);  // NOLINT
+
+  g_free(launcher);
 }
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include "cobalt-affinity.h"
+#include "cobalt-env.h"
 #include "cobalt-host.h"
+#include "cobalt-sched.h"
 
 #include <gio/gio.h>
 #include <glib.h>
@@ -26,6 +29,12 @@ void cobalt_launcher_zypak_set_sandbox_filename(CobaltLauncher *launcher,
 void cobalt_launcher_zypak_expose_widevine_path(CobaltLauncher *launcher,
                                                 const char *widevine_path);
 
+void cobalt_launcher_set_sched_policy(CobaltLauncher *launcher,
+                                      const CobaltSchedPolicy *policy);
+
+void cobalt_launcher_set_affinity(CobaltLauncher *launcher,
+                                  const CobaltAffinity *affinity);
+
 void cobalt_launcher_set_feature(CobaltLauncher *launcher, const char *feature,
                                  CobaltLauncherFeatureStatus status);
 void cobalt_launcher_set_features(CobaltLauncher *launcher, char **features,
@@ -34,10 +43,29 @@ void cobalt_launcher_set_features(CobaltLauncher *launcher, char **features,
 gboolean cobalt_launcher_read_flags_file(CobaltLauncher *launcher, GFile *file,
                                          GError **error);
 
+// Environment edits are applied in the order they were added, on top of the
+// environment set up by the launcher itself.
+void cobalt_launcher_setenv(CobaltLauncher *launcher, const char *variable,
+                            const char *value);
+void cobalt_launcher_add_env_edit(CobaltLauncher *launcher, const CobaltEnvEdit *edit);
+void cobalt_launcher_add_env_edits(CobaltLauncher *launcher, GPtrArray *edits);
+
 void cobalt_launcher_add_arg(CobaltLauncher *launcher, const char *arg);
 void cobalt_launcher_add_argv(CobaltLauncher *launcher, char **argv);
 
+// Resolves the final arguments and sets up the environment and scheduling policy
+// of the calling process for the browser. Can only be called once, and nothing
+// may be added to the launcher afterwards.
+gboolean cobalt_launcher_prepare(CobaltLauncher *launcher, GError **error);
+
+// Replaces the calling process with the browser, preparing the launcher first
+// if that wasn't done yet. Only returns on failure.
 void cobalt_launcher_exec(CobaltLauncher *launcher, GError **error);
+// Starts the browser as an unreaped child of the calling process, which can be
+// done any number of times once the launcher is prepared. extra_args, which may
+// be NULL, are appended for this process only.
+GPid cobalt_launcher_spawn(CobaltLauncher *launcher, const char *const *extra_args,
+                           GError **error);
 
 void cobalt_launcher_free(CobaltLauncher *launcher);
 
@@ -3,9 +3,28 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #include "cobalt-alert.h"
+#include "cobalt-cache.h"
 #include "cobalt-config.h"
+#include "cobalt-fonts.h"
+#include "cobalt-fs.h"
+#include "cobalt-helper.h"
 #include "cobalt-host.h"
 #include "cobalt-launcher.h"
+#include "cobalt-maintenance.h"
+#include "cobalt-memory.h"
+#include "cobalt-pool.h"
+#include "cobalt-power.h"
+#include "cobalt-prefetch.h"
+#include "cobalt-pressure.h"
+#include "cobalt-profile-ram.h"
+#include "cobalt-profile.h"
+#include "cobalt-session.h"
+#include "cobalt-shm.h"
+#include "cobalt-state.h"
+#include "cobalt-template.h"
+#include "cobalt-supervisor.h"
+#include "cobalt-util.h"
+#include "cobalt-watchdog.h"
 
 #include <gtk/gtk.h>
 #include <string.h>
@@ -14,6 +33,33 @@
 #define COBALT_EXPOSE_PIDS_ALERT_ERROR_TITLE "Fatal Error"
 #define COBALT_EXPOSE_PIDS_ALERT_WARNING_TITLE "Warning"
 
+#define COBALT_EXECUTABLE_NAME "cobalt"
+
+#define COBALT_ARG_PREFIX "--cobalt-"
+#define COBALT_ARG_PRESET COBALT_ARG_PREFIX "preset="
+#define COBALT_ARG_SUPERVISE COBALT_ARG_PREFIX "supervise"
+#define COBALT_ARG_HEADLESS COBALT_ARG_PREFIX "headless"
+#define COBALT_ARG_PRELOAD COBALT_ARG_PREFIX "preload"
+#define COBALT_ARG_POOL COBALT_ARG_PREFIX "pool="
+#define COBALT_ARG_POOL_DIR COBALT_ARG_PREFIX "pool-dir="
+#define COBALT_ARG_POOL_MANIFEST COBALT_ARG_PREFIX "pool-manifest="
+#define COBALT_ARG_MEMORY_REPORT COBALT_ARG_PREFIX "memory-report"
+#define COBALT_ARG_MEMORY_REPORT_INTERVAL COBALT_ARG_PREFIX "memory-report-interval="
+#define COBALT_ARG_MEMORY_REPORT_COUNT COBALT_ARG_PREFIX "memory-report-count="
+
+#define COBALT_MEMORY_REPORT_FORMAT_TABLE_NAME "table"
+#define COBALT_MEMORY_REPORT_FORMAT_JSON_NAME "json"
+
+#define COBALT_POOL_MAX_SIZE 1024
+#define COBALT_POOL_DIR_TEMPLATE "cobalt-pool-XXXXXX"
+#define COBALT_POOL_MANIFEST "manifest.json"
+
+#define COBALT_PRESET_ENV "COBALT_PRESET"
+
+#define COBALT_USER_PROFILE_TEMPLATE_FORMAT "%s-profile-template"
+
+#define BROWSER_ARG_USER_DATA_DIR "--user-data-dir="
+
 #define COBALT_STAMP_FIRST_RUN "run"
 // Note that the name is "mimic" for legacy reasons, to work with the existing
 // stamp files all the Chrome-based Flatpaks use.
@@ -23,6 +69,15 @@
 #define COBALT_RESOURCE_EXPOSE_PIDS_WARNING "/cobalt/expose-pids-warning.xml"
 #define COBALT_RESOURCE_EXPOSE_PIDS_GUIDE "/cobalt/expose-pids-guide.xml"
 
+// Browser arguments that mean there's no one in front of a display, and thus
+// imply --cobalt-headless.
+static const char *HEADLESS_BROWSER_ARGS[] = {
+    "--headless",
+    "--remote-debugging-port",
+    "--remote-debugging-pipe",
+    NULL,
+};
+
 static char *DEFAULT_ENABLED_FEATURES[] = {NULL};
 
 static char *DEFAULT_DISABLED_FEATURES[] = {
@@ -31,6 +86,182 @@ static char *DEFAULT_DISABLED_FEATURES[] = {
     NULL,
 };
 
+typedef struct CobaltOptions CobaltOptions;
+
+// Options controlling cobalt itself, which are stripped from the arguments
+// before they are forwarded to the browser.
+struct CobaltOptions {
+  char *preset;
+  gboolean supervise;
+  // Skips everything that only matters for a desktop session.
+  gboolean headless;
+  // Starts the browser in the background, without any windows.
+  gboolean preload;
+  // The absolute path of any --user-data-dir= that is forwarded to the browser.
+  char *user_data_dir;
+
+  // Number of instances to start in pool mode, or 0 to start just one.
+  guint pool_size;
+  char *pool_dir;
+  char *pool_manifest;
+
+  // Prints a memory report of the running browser instead of starting it.
+  gboolean memory_report;
+  CobaltMemoryReportFormat memory_report_format;
+  // In seconds, or 0 to only print a single report.
+  guint memory_report_interval;
+  guint memory_report_count;
+};
+
+static void cobalt_options_clear(CobaltOptions *options) {
+  g_clear_pointer(&options->preset, g_free);
+  g_clear_pointer(&options->user_data_dir, g_free);
+  g_clear_pointer(&options->pool_dir, g_free);
+  g_clear_pointer(&options->pool_manifest, g_free);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(CobaltOptions, cobalt_options_clear)
+
+static gboolean is_headless_browser_arg(const char *arg) {
+  for (const char **headless_arg = HEADLESS_BROWSER_ARGS; *headless_arg != NULL;
+       headless_arg++) {
+    if (g_str_has_prefix(arg, *headless_arg)) {
+      char next = arg[strlen(*headless_arg)];
+      if (next == '\0' || next == '=') {
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean parse_memory_report_format(const char *name,
+                                           CobaltMemoryReportFormat *format) {
+  if (g_str_equal(name, COBALT_MEMORY_REPORT_FORMAT_TABLE_NAME)) {
+    *format = COBALT_MEMORY_REPORT_FORMAT_TABLE;
+  } else if (g_str_equal(name, COBALT_MEMORY_REPORT_FORMAT_JSON_NAME)) {
+    *format = COBALT_MEMORY_REPORT_FORMAT_JSON;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GStrv parse_cobalt_options(char **argv, CobaltOptions *options) {
+  g_autoptr(GPtrArray) forwarded = g_ptr_array_new_with_free_func(g_free);
+
+  for (; argv && *argv != NULL; argv++) {
+    if (g_str_has_prefix(*argv, COBALT_ARG_PRESET)) {
+      g_clear_pointer(&options->preset, g_free);
+      options->preset = g_strdup(*argv + strlen(COBALT_ARG_PRESET));
+    } else if (g_str_equal(*argv, COBALT_ARG_SUPERVISE)) {
+      options->supervise = TRUE;
+    } else if (g_str_equal(*argv, COBALT_ARG_HEADLESS)) {
+      options->headless = TRUE;
+    } else if (g_str_equal(*argv, COBALT_ARG_PRELOAD)) {
+      options->preload = TRUE;
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_POOL)) {
+      guint64 pool_size = 0;
+      if (g_ascii_string_to_unsigned(*argv + strlen(COBALT_ARG_POOL), 10, 1,
+                                     COBALT_POOL_MAX_SIZE, &pool_size, NULL)) {
+        options->pool_size = pool_size;
+      } else {
+        g_warning("Invalid pool size: %s", *argv + strlen(COBALT_ARG_POOL));
+      }
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_POOL_DIR)) {
+      g_clear_pointer(&options->pool_dir, g_free);
+      options->pool_dir = g_strdup(*argv + strlen(COBALT_ARG_POOL_DIR));
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_POOL_MANIFEST)) {
+      g_clear_pointer(&options->pool_manifest, g_free);
+      options->pool_manifest = g_strdup(*argv + strlen(COBALT_ARG_POOL_MANIFEST));
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_MEMORY_REPORT_INTERVAL)) {
+      guint64 interval = 0;
+      if (g_ascii_string_to_unsigned(*argv + strlen(COBALT_ARG_MEMORY_REPORT_INTERVAL),
+                                     10, 0, G_MAXUINT, &interval, NULL)) {
+        options->memory_report_interval = interval;
+      } else {
+        g_warning("Invalid memory report interval: %s",
+                  *argv + strlen(COBALT_ARG_MEMORY_REPORT_INTERVAL));
+      }
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_MEMORY_REPORT_COUNT)) {
+      guint64 count = 0;
+      if (g_ascii_string_to_unsigned(*argv + strlen(COBALT_ARG_MEMORY_REPORT_COUNT), 10,
+                                     0, G_MAXUINT, &count, NULL)) {
+        options->memory_report_count = count;
+      } else {
+        g_warning("Invalid memory report count: %s",
+                  *argv + strlen(COBALT_ARG_MEMORY_REPORT_COUNT));
+      }
+    } else if (g_str_equal(*argv, COBALT_ARG_MEMORY_REPORT)) {
+      options->memory_report = TRUE;
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_MEMORY_REPORT "=")) {
+      const char *format = *argv + strlen(COBALT_ARG_MEMORY_REPORT "=");
+      options->memory_report = TRUE;
+      if (!parse_memory_report_format(format, &options->memory_report_format)) {
+        g_warning("Invalid memory report format: %s", format);
+      }
+    } else if (g_str_has_prefix(*argv, COBALT_ARG_PREFIX)) {
+      g_warning("Unknown cobalt argument: %s", *argv);
+    } else {
+      options->headless |= is_headless_browser_arg(*argv);
+      if (g_str_has_prefix(*argv, BROWSER_ARG_USER_DATA_DIR) &&
+          (*argv)[strlen(BROWSER_ARG_USER_DATA_DIR)] != '\0') {
+        g_clear_pointer(&options->user_data_dir, g_free);
+        options->user_data_dir =
+            g_canonicalize_filename(*argv + strlen(BROWSER_ARG_USER_DATA_DIR), NULL);
+      }
+
+      g_ptr_array_add(forwarded, g_strdup(*argv));
+    }
+  }
+
+  if (options->preset == NULL) {
+    options->preset = g_strdup(g_getenv(COBALT_PRESET_ENV));
+  }
+
+  g_ptr_array_add(forwarded, NULL);
+  return (GStrv)g_ptr_array_free(g_steal_pointer(&forwarded), FALSE);
+}
+
+// If cobalt was installed or symlinked under another name, e.g. as
+// /app/bin/brave, then it takes the place of the wrapper script itself.
+static void apply_invocation_name(CobaltConfig *config, const char *argv0) {
+  g_autofree char *basename = g_path_get_basename(argv0);
+  if (g_str_equal(basename, COBALT_EXECUTABLE_NAME)) {
+    return;
+  }
+
+  g_autofree char *self = NULL;
+  if (strchr(argv0, '/') != NULL) {
+    // Not resolved any further, since the browser should re-run cobalt under
+    // the same name.
+    self = g_canonicalize_filename(argv0, NULL);
+  } else {
+    self = g_find_program_in_path(argv0);
+  }
+
+  if (self == NULL) {
+    g_warning("Failed to find '%s' in PATH, not using it as the wrapper script", argv0);
+    return;
+  }
+
+  g_debug("Invoked as '%s'", self);
+
+  if (!config->application.name) {
+    config->application.name = g_steal_pointer(&basename);
+    g_debug("Inferred application name '%s' from invocation",
+            config->application.name);
+  }
+
+  if (!config->application.wrapper_script) {
+    config->application.wrapper_script = g_steal_pointer(&self);
+    g_debug("Inferred wrapper script '%s' from invocation",
+            config->application.wrapper_script);
+  }
+}
+
 static char *infer_application_name(CobaltHost *host, GError **error) {
   const char *app_id = cobalt_host_get_app_id(host, error);
   if (app_id == NULL) {
@@ -53,12 +284,14 @@ static char *infer_application_name(CobaltHost *host, GError **error) {
 }
 
 static char *infer_entry_point(const char *name, GError **error) {
-  g_autofree char *path = g_build_filename("/app", name, name, NULL);
+  g_autofree char *app_dir = cobalt_util_get_root_path("/app");
+
+  g_autofree char *path = g_build_filename(app_dir, name, name, NULL);
   if (access(path, F_OK | X_OK) != -1) {
     return g_steal_pointer(&path);
   }
 
-  g_autofree char *extra_path = g_build_filename("/app", "extra", name, NULL);
+  g_autofree char *extra_path = g_build_filename(app_dir, "extra", name, NULL);
   if (access(extra_path, F_OK | X_OK) != -1) {
     return g_steal_pointer(&extra_path);
   }
@@ -121,7 +354,10 @@ static char *infer_sandbox_filename(const char *name, const char *entry_point,
   return NULL;
 }
 
-static gboolean fill_defaults(CobaltConfig *config, CobaltHost *host, GError **error) {
+// In headless mode, the defaults that only matter for desktop integration are
+// left unset instead of being inferred.
+static gboolean fill_defaults(CobaltConfig *config, CobaltHost *host, gboolean headless,
+                              GError **error) {
   if (!config->application.name) {
     config->application.name = infer_application_name(host, error);
     if (!config->application.name) {
@@ -142,7 +378,7 @@ static gboolean fill_defaults(CobaltConfig *config, CobaltHost *host, GError **e
     g_debug("Inferred entry point '%s'", config->application.entry_point);
   }
 
-  if (!config->application.wrapper_script) {
+  if (!config->application.wrapper_script && !headless) {
     config->application.wrapper_script = infer_wrapper_script(host, error);
     if (!config->application.wrapper_script) {
       g_prefix_error(error, "Failed to infer wrapper script: ");
@@ -169,7 +405,9 @@ static gboolean fill_defaults(CobaltConfig *config, CobaltHost *host, GError **e
     }
   }
 
-  if (!config->flextop.enabled_was_set_by_user) {
+  if (headless) {
+    config->flextop.enabled = FALSE;
+  } else if (!config->flextop.enabled_was_set_by_user) {
     if (!cobalt_host_get_flextop_available(host, &config->flextop.enabled, error)) {
       g_prefix_error(error, "Failed to get Flextop status: ");
       return FALSE;
@@ -266,20 +504,277 @@ static void flextop_init(CobaltConfig *config) {
   }
 }
 
-static CobaltLauncher *setup_launcher(CobaltConfig *config, CobaltHost *host) {
+static void apply_preset(CobaltLauncher *launcher, const char *name,
+                         CobaltConfigPreset *preset) {
+  g_debug("Applying preset '%s'", name);
+
+  cobalt_launcher_set_features(launcher, preset->enabled_features,
+                               COBALT_LAUNCHER_FEATURE_ENABLED);
+  cobalt_launcher_set_features(launcher, preset->disabled_features,
+                               COBALT_LAUNCHER_FEATURE_DISABLED);
+  cobalt_launcher_add_argv(launcher, preset->flags);
+  cobalt_launcher_add_env_edits(launcher, preset->environment);
+}
+
+static void apply_preset_by_name(CobaltConfig *config, CobaltLauncher *launcher,
+                                 const char *name) {
+  CobaltConfigPreset *preset = cobalt_config_get_preset(config, name);
+  if (preset != NULL) {
+    apply_preset(launcher, name, preset);
+  } else {
+    g_warning("Unknown preset '%s'", name);
+  }
+}
+
+static void apply_power_tuning(CobaltConfig *config, CobaltLauncher *launcher) {
+  g_auto(CobaltPowerState) power = {0};
+  cobalt_power_get_state(&power);
+  g_debug("Power state: on battery: %d, battery: %d%%, platform profile: %s",
+          power.on_battery, power.battery_percent,
+          power.platform_profile != NULL ? power.platform_profile : "none");
+
+  gboolean save_power = power.on_battery;
+  if (!save_power && config->power.low_power_profile_as_battery &&
+      cobalt_power_state_is_low_power_profile(&power)) {
+    save_power = TRUE;
+  }
+
+  if (!save_power) {
+    return;
+  }
+
+  if (config->power.battery_preset != NULL) {
+    apply_preset_by_name(config, launcher, config->power.battery_preset);
+  }
+
+  if (config->power.low_battery_preset != NULL && power.on_battery &&
+      power.battery_percent != -1 &&
+      (guint)power.battery_percent <= config->power.low_battery_threshold) {
+    apply_preset_by_name(config, launcher, config->power.low_battery_preset);
+  }
+}
+
+static gboolean pressure_exceeds(CobaltPressureResource resource, guint threshold) {
+  if (threshold == 0) {
+    return FALSE;
+  }
+
+  g_autoptr(GError) error = NULL;
+  double some_avg10 = 0;
+  if (!cobalt_pressure_read(resource, &some_avg10, &error)) {
+    if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_debug("Pressure stall information is unavailable");
+    } else {
+      g_warning("Failed to read %s pressure: %s",
+                cobalt_pressure_resource_to_string(resource), error->message);
+    }
+    return FALSE;
+  }
+
+  g_debug("%s pressure is %.2f%%, threshold is %u%%",
+          cobalt_pressure_resource_to_string(resource), some_avg10, threshold);
+  return some_avg10 >= threshold;
+}
+
+// Starting the browser while the system is already stalling on memory or I/O
+// only makes matters worse, so it's started with conservative settings instead.
+static gboolean check_pressure(CobaltConfig *config) {
+  // Every resource is read, so the debug output covers all of them.
+  gboolean under_pressure =
+      pressure_exceeds(COBALT_PRESSURE_CPU, config->pressure.cpu_threshold);
+  under_pressure |=
+      pressure_exceeds(COBALT_PRESSURE_MEMORY, config->pressure.memory_threshold);
+  under_pressure |= pressure_exceeds(COBALT_PRESSURE_IO, config->pressure.io_threshold);
+
+  if (under_pressure) {
+    g_debug("System is under pressure, launching conservatively");
+  }
+
+  return under_pressure;
+}
+
+static void prefetch_profile(CobaltConfig *config, CobaltOptions *options) {
+  g_autofree char *profile_dir = NULL;
+  if (options->user_data_dir != NULL) {
+    profile_dir = g_strdup(options->user_data_dir);
+  } else if (config->application.config_dir != NULL) {
+    profile_dir =
+        g_build_filename(g_get_user_config_dir(), config->application.config_dir, NULL);
+  } else {
+    return;
+  }
+
+  g_autoptr(GError) error = NULL;
+  if (!cobalt_prefetch_profile(config, profile_dir, &error)) {
+    g_debug("Failed to prefetch profile: %s", error->message);
+  }
+}
+
+// Restoring hundreds of tabs at once can keep the machine busy for minutes, so
+// large sessions get the presets meant to throttle that, and huge ones can be
+// set aside entirely.
+static void mitigate_session_restore(CobaltConfig *config, CobaltLauncher *launcher,
+                                     const char *profile_dir) {
+  // Only the first instance restores anything.
+  if (cobalt_profile_is_running(profile_dir)) {
+    return;
+  }
+
+  CobaltSessionStats stats;
+  cobalt_session_estimate(profile_dir, &stats);
+  g_debug("Saved session has %u tabs in %u windows", stats.tabs, stats.windows);
+
+  gboolean is_large = config->session_restore.large_threshold != 0 &&
+                      stats.tabs >= config->session_restore.large_threshold;
+  gboolean is_huge = config->session_restore.huge_threshold != 0 &&
+                     stats.tabs >= config->session_restore.huge_threshold;
+
+  if (is_huge && config->session_restore.defer_huge) {
+    g_autoptr(GError) error = NULL;
+    if (cobalt_session_defer(profile_dir, &error)) {
+      // There's nothing left to restore.
+      return;
+    }
+
+    g_warning("Failed to defer session restore: %s", error->message);
+  }
+
+  if (is_large && config->session_restore.large_preset != NULL) {
+    apply_preset_by_name(config, launcher, config->session_restore.large_preset);
+  }
+
+  if (is_huge && config->session_restore.huge_preset != NULL) {
+    apply_preset_by_name(config, launcher, config->session_restore.huge_preset);
+  }
+}
+
+static char *setup_profile_in_ram(CobaltConfig *config, CobaltHost *host,
+                                  const char *persistent_dir, GError **error) {
+  const char *app_id = cobalt_host_get_app_id(host, error);
+  if (app_id == NULL) {
+    g_prefix_error(error, "Failed to get app ID: ");
+    return NULL;
+  }
+
+  return cobalt_profile_ram_setup(app_id, persistent_dir,
+                                  config->profile_in_ram.sync_interval, error);
+}
+
+// A template in the user's config dir, next to the flags file, takes precedence
+// over the one from the config file.
+static char *find_profile_template(CobaltConfig *config) {
+  g_autofree char *user_template_name =
+      g_strdup_printf(COBALT_USER_PROFILE_TEMPLATE_FORMAT, config->application.name);
+  g_autofree char *user_template =
+      g_build_filename(g_get_user_config_dir(), user_template_name, NULL);
+  if (g_file_test(user_template, G_FILE_TEST_IS_DIR)) {
+    return g_steal_pointer(&user_template);
+  }
+
+  if (config->application.profile_template != NULL &&
+      g_file_test(config->application.profile_template, G_FILE_TEST_IS_DIR)) {
+    return g_strdup(config->application.profile_template);
+  }
+
+  return NULL;
+}
+
+static gboolean schedule_maintenance(CobaltConfig *config, CobaltHost *host,
+                                     CobaltState *state, const char *profile_dir,
+                                     gboolean postpone, GError **error) {
+  const char *app_id = cobalt_host_get_app_id(host, error);
+  if (app_id == NULL) {
+    g_prefix_error(error, "Failed to get app ID: ");
+    return FALSE;
+  }
+
+  return cobalt_maintenance_schedule(config, state, app_id, profile_dir, postpone,
+                                     error);
+}
+
+// The directory the browser will use as its profile, if known, is returned in
+// profile_dir_out.
+static CobaltLauncher *setup_launcher(CobaltConfig *config, CobaltHost *host,
+                                      CobaltState *state, CobaltOptions *options,
+                                      gboolean under_pressure, char **profile_dir_out) {
   g_autoptr(GError) error = NULL;
 
   g_autoptr(CobaltLauncher) launcher = cobalt_launcher_new(
       host, config->application.entry_point, config->application.wrapper_script);
+
+  g_autofree char *profile_dir = NULL;
+  if (config->application.config_dir != NULL) {
+    profile_dir =
+        g_build_filename(g_get_user_config_dir(), config->application.config_dir, NULL);
+  }
+
+  // Pool instances each get their own user data directory, so nothing that works
+  // on the profile applies to them. They're seeded from the template separately.
+  gboolean pool = options->pool_size != 0;
+
+  g_autofree char *profile_template = find_profile_template(config);
+  const char *template_target =
+      options->user_data_dir != NULL ? options->user_data_dir : profile_dir;
+  if (profile_template != NULL && template_target != NULL && !pool &&
+      !cobalt_template_clone(profile_template, template_target, &error)) {
+    g_warning("Failed to create profile from template: %s", error->message);
+    g_clear_error(&error);
+  }
+
+  gboolean defer_optional_work = under_pressure && config->pressure.defer_optional_work;
+
+  if (config->maintenance.enabled && !pool) {
+    g_warn_if_fail(profile_dir);
+    // The sync helper writes the persistent profile right as the browser exits,
+    // which is exactly when a maintenance pass would start.
+    if (config->profile_in_ram.enabled) {
+      g_debug("Skipping profile maintenance, since the profile is kept in RAM");
+    } else if (!schedule_maintenance(config, host, state, profile_dir,
+                                     defer_optional_work, &error)) {
+      g_warning("Failed to schedule profile maintenance: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  if (config->profile_in_ram.enabled && !pool) {
+    g_warn_if_fail(profile_dir);
+    g_autofree char *ram_profile_dir =
+        setup_profile_in_ram(config, host, profile_dir, &error);
+    if (ram_profile_dir != NULL) {
+      g_autofree char *user_data_dir_flag =
+          g_strdup_printf("--user-data-dir=%s", ram_profile_dir);
+      cobalt_launcher_add_arg(launcher, user_data_dir_flag);
+
+      g_clear_pointer(&profile_dir, g_free);
+      profile_dir = g_steal_pointer(&ram_profile_dir);
+    } else {
+      g_warning("Failed to move profile into RAM: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  cobalt_launcher_set_sched_policy(launcher, &config->scheduling);
+
+  if (config->affinity.policy != COBALT_AFFINITY_POLICY_NONE) {
+    CobaltAffinity affinity;
+    if (cobalt_affinity_compute(config->affinity.policy, config->affinity.numa_node,
+                                config->affinity.performance_threshold, &affinity,
+                                &error)) {
+      cobalt_launcher_set_affinity(launcher, &affinity);
+    } else if (error != NULL) {
+      g_warning("Failed to compute CPU affinity: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
   if (config->zypak.enabled) {
     cobalt_launcher_zypak_enable(launcher);
     cobalt_launcher_zypak_set_sandbox_filename(launcher, config->zypak.sandbox_filename);
     if (config->zypak.expose_widevine) {
-      g_warn_if_fail(config->application.config_dir);
+      g_warn_if_fail(profile_dir);
       g_warn_if_fail(config->zypak.widevine_path);
       g_autofree char *widevine_path =
-          g_build_filename(g_get_user_config_dir(), config->application.config_dir,
-                           config->zypak.widevine_path, NULL);
+          g_build_filename(profile_dir, config->zypak.widevine_path, NULL);
       cobalt_launcher_zypak_expose_widevine_path(launcher, widevine_path);
     }
   }
@@ -294,6 +789,56 @@ static CobaltLauncher *setup_launcher(CobaltConfig *config, CobaltHost *host) {
   cobalt_launcher_set_features(launcher, config->default_features.disabled,
                                COBALT_LAUNCHER_FEATURE_DISABLED);
 
+  cobalt_launcher_add_env_edits(launcher, config->environment);
+
+  // Applied before anything the user picked explicitly (the preset and the flags
+  // file), so those always win.
+  if (config->power.enabled) {
+    apply_power_tuning(config, launcher);
+  }
+
+  if (under_pressure && config->pressure.preset != NULL) {
+    apply_preset_by_name(config, launcher, config->pressure.preset);
+  }
+
+  const char *preset_name =
+      options->preset != NULL ? options->preset : config->application.default_preset;
+  if (preset_name != NULL && *preset_name != '\0') {
+    apply_preset_by_name(config, launcher, preset_name);
+  }
+
+  if (config->session_restore.enabled && !options->headless && !pool) {
+    g_warn_if_fail(profile_dir);
+    mitigate_session_restore(config, launcher, profile_dir);
+  }
+
+  if (profile_dir != NULL && !pool &&
+      (config->filesystem.no_cow || config->filesystem.local_caches) &&
+      !cobalt_fs_tune_profile(config, state, profile_dir, &error)) {
+    g_warning("Failed to tune profile for its filesystem: %s", error->message);
+    g_clear_error(&error);
+  }
+
+  // A relocated cache would be shared by all instances, which the browser's cache
+  // backends don't support, so they keep their caches in their own profiles.
+  if (pool) {
+    g_debug("Leaving caches in the pool instances' profiles");
+  } else if (!cobalt_cache_setup(config, profile_dir, launcher, &error)) {
+    g_warning("Failed to set up cache location: %s", error->message);
+    g_clear_error(&error);
+  }
+
+  if (config->shared_memory.enabled &&
+      !cobalt_shm_check(config, host, launcher, &error)) {
+    g_warning("Failed to check shared memory space: %s", error->message);
+    g_clear_error(&error);
+  }
+
+  if (!pool && !cobalt_cache_check_gpu_driver(host, state, profile_dir, &error)) {
+    g_warning("Failed to check for GPU driver changes: %s", error->message);
+    g_clear_error(&error);
+  }
+
   g_autofree char *flags_filename =
       g_strdup_printf("%s-flags.conf", config->application.name);
   g_autoptr(GFile) flags_file =
@@ -324,20 +869,195 @@ static CobaltLauncher *setup_launcher(CobaltConfig *config, CobaltHost *host) {
     g_clear_error(&error);
   }
 
+  g_autofree char *environment_filename =
+      g_strdup_printf("%s-environment.conf", config->application.name);
+  g_autoptr(GFile) environment_file =
+      g_file_new_build_filename(g_get_user_config_dir(), environment_filename, NULL);
+  g_autoptr(GPtrArray) environment = cobalt_env_read_file(environment_file, &error);
+  if (environment != NULL) {
+    cobalt_launcher_add_env_edits(launcher, environment);
+  } else {
+    g_warning("Failed to read environment file '%s': %s",
+              g_file_peek_path(environment_file), error->message);
+    g_clear_error(&error);
+  }
+
+  *profile_dir_out = g_steal_pointer(&profile_dir);
   return g_steal_pointer(&launcher);
 }
 
+typedef struct SupervisorRestart {
+  CobaltConfig *config;
+  CobaltHost *host;
+  // The directory the browser actually runs on, which is the copy in RAM if
+  // that was set up.
+  const char *profile_dir;
+} SupervisorRestart;
+
+// The RAM sync and maintenance helpers decide the browser is gone once nothing
+// has launched it for a while, so a restart has to go through the same
+// handshake as the original launch.
+static gboolean prepare_restart(gpointer user_data, GError **error) {
+  SupervisorRestart *restart = user_data;
+  CobaltConfig *config = restart->config;
+  if (config->application.config_dir == NULL || restart->profile_dir == NULL) {
+    return TRUE;
+  }
+
+  const char *app_id = cobalt_host_get_app_id(restart->host, error);
+  if (app_id == NULL) {
+    g_prefix_error(error, "Failed to get app ID: ");
+    return FALSE;
+  }
+
+  g_autofree char *ram_profile_dir = cobalt_profile_ram_get_dir(app_id);
+  if (config->profile_in_ram.enabled &&
+      g_str_equal(restart->profile_dir, ram_profile_dir)) {
+    // Brings the copy back if the helper already synced and removed it.
+    g_autofree char *persistent_dir =
+        g_build_filename(g_get_user_config_dir(), config->application.config_dir, NULL);
+    g_autofree char *ready_dir =
+        setup_profile_in_ram(config, restart->host, persistent_dir, error);
+    return ready_dir != NULL;
+  }
+
+  if (config->maintenance.enabled) {
+    return cobalt_maintenance_interrupt(app_id, error);
+  }
+
+  return TRUE;
+}
+
+static void save_state(CobaltState *state) {
+  g_autoptr(GError) error = NULL;
+  if (!cobalt_state_save(state, &error)) {
+    g_warning("%s", error->message);
+  }
+}
+
+// Checked before the launcher is set up, since that already does work on the
+// profile that a skipped preload shouldn't leave behind.
+static gboolean should_preload(CobaltConfig *config, CobaltHost *host) {
+  if (!config->preload.enabled) {
+    g_debug("Preloading is disabled");
+    return FALSE;
+  }
+
+  // Anything opened later goes to the running instance anyway. With the profile
+  // in RAM, the running instance uses the copy instead.
+  g_autofree char *profile_dir = NULL;
+  if (config->application.config_dir != NULL) {
+    profile_dir =
+        g_build_filename(g_get_user_config_dir(), config->application.config_dir, NULL);
+  }
+
+  const char *app_id = NULL;
+  g_autofree char *ram_profile_dir = NULL;
+  if (config->profile_in_ram.enabled &&
+      (app_id = cobalt_host_get_app_id(host, NULL)) != NULL) {
+    ram_profile_dir = cobalt_profile_ram_get_dir(app_id);
+  }
+
+  if ((profile_dir != NULL && cobalt_profile_is_running(profile_dir)) ||
+      (ram_profile_dir != NULL && cobalt_profile_is_running(ram_profile_dir))) {
+    g_debug("Browser is already running, not preloading");
+    return FALSE;
+  }
+
+  if (config->preload.min_available_memory_mb != 0) {
+    g_autoptr(GError) error = NULL;
+    guint64 available = 0;
+    if (!cobalt_util_read_meminfo("MemAvailable", &available, &error)) {
+      g_warning("Failed to get available memory: %s", error->message);
+      return FALSE;
+    }
+
+    if (available / 1024 / 1024 < config->preload.min_available_memory_mb) {
+      g_debug("Only %" G_GUINT64_FORMAT "MiB of memory available, not preloading",
+              available / 1024 / 1024);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+// The browser starts without a window, and with idle I/O for a while so it
+// doesn't compete with the rest of the session starting up. The helper that
+// restores the I/O priority afterwards covers the entire tree.
+static void setup_preload(CobaltConfig *config, CobaltLauncher *launcher) {
+  cobalt_launcher_add_arg(launcher, "--no-startup-window");
+
+  if (config->preload.low_priority_duration != 0) {
+    CobaltSchedPolicy policy = config->scheduling;
+    policy.startup_io_boost = config->preload.low_priority_duration;
+    policy.startup_io_class = COBALT_SCHED_IO_CLASS_IDLE;
+    policy.startup_io_level = 0;
+    cobalt_launcher_set_sched_policy(launcher, &policy);
+  }
+}
+
+static int run_pool(CobaltConfig *config, CobaltLauncher *launcher,
+                    CobaltOptions *options) {
+  g_autoptr(GError) error = NULL;
+
+  g_autofree char *pool_dir = g_strdup(options->pool_dir);
+  if (pool_dir == NULL) {
+    pool_dir = g_dir_make_tmp(COBALT_POOL_DIR_TEMPLATE, &error);
+    if (pool_dir == NULL) {
+      g_critical("Failed to create pool directory: %s", error->message);
+      return 1;
+    }
+  }
+
+  g_autofree char *manifest_path =
+      options->pool_manifest != NULL
+          ? g_strdup(options->pool_manifest)
+          : g_build_filename(pool_dir, COBALT_POOL_MANIFEST, NULL);
+
+  if (!cobalt_launcher_prepare(launcher, &error)) {
+    g_critical("Failed to prepare launch: %s", error->message);
+    return 1;
+  }
+
+  g_autofree char *profile_template = find_profile_template(config);
+  return cobalt_pool_run(launcher, options->pool_size, pool_dir, manifest_path,
+                         profile_template);
+}
+
 int main(int argc, char **argv) {
-  gboolean is_gtk_available = gtk_init_check(0, NULL);
+  if (cobalt_helper_is_invocation(argc, argv)) {
+    return cobalt_helper_run(argc, argv);
+  }
+
+  cobalt_watchdog_mark_phase("start");
 
   g_autoptr(GError) error = NULL;
 
+  g_auto(CobaltOptions) options = {0};
+  g_auto(GStrv) forwarded_argv = parse_cobalt_options(argv + 1, &options);
+
   g_autoptr(CobaltConfig) config = cobalt_config_load(&error);
   if (config == NULL) {
     g_printerr("Failed to load config file: %s\n", error->message);
     return 1;
   }
 
+  apply_invocation_name(config, argv[0]);
+  cobalt_watchdog_mark_phase("config");
+
+  gboolean under_pressure = config->pressure.enabled && check_pressure(config);
+
+  // Started before anything else, so the reads overlap with the portal calls and
+  // the rest of the setup.
+  if (config->prefetch.enabled && !options.memory_report && options.pool_size == 0) {
+    if (under_pressure && config->pressure.defer_optional_work) {
+      g_debug("Postponing profile prefetch");
+    } else {
+      prefetch_profile(config, &options);
+    }
+  }
+
   g_autoptr(CobaltHost) host = cobalt_host_new(&error);
   if (host == NULL) {
     g_printerr("Failed to initialize (is the Flatpak D-Bus portal working?): %s\n",
@@ -345,17 +1065,47 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  if (!fill_defaults(config, host, &error)) {
+  cobalt_watchdog_mark_phase("host");
+
+  if (options.headless) {
+    g_debug("Running headless, skipping desktop integration");
+  }
+
+  if (!fill_defaults(config, host, options.headless, &error)) {
     g_printerr("Failed to fill defaults: %s\n", error->message);
     return 1;
   }
 
+  if (options.memory_report) {
+    return cobalt_memory_report_run(
+        config->application.entry_point, options.memory_report_format,
+        options.memory_report_interval, options.memory_report_count);
+  }
+
+  cobalt_watchdog_mark_phase("defaults");
+
+  g_autoptr(CobaltState) state = cobalt_state_load(config->application.name);
+
+  // Done as early as possible, to give the rebuild a head start on the browser.
+  if (config->fonts.warm_up) {
+    if (under_pressure && config->pressure.defer_optional_work) {
+      g_debug("Postponing font cache warm-up");
+    } else if (!cobalt_fonts_warm_up(host, state, &error)) {
+      g_warning("Failed to warm up font caches: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  cobalt_watchdog_mark_phase("fonts");
+
   if (config->application.expose_pids != COBALT_CONFIG_EXPOSE_PIDS_OPTIONAL) {
     gboolean expose_pids_available = FALSE;
     cobalt_host_get_expose_pids_available(host, &expose_pids_available);
 
     if (!expose_pids_available) {
-      if (is_gtk_available) {
+      // GTK is only initialized here, since it's the only thing that needs it. A
+      // preload happens at login, so the dialog waits for a launch by the user.
+      if (!options.headless && !options.preload && gtk_init_check(0, NULL)) {
         show_expose_pids_alert(config);
       } else {
         g_warning("'expose-pids' support is %s but unavailable",
@@ -370,13 +1120,32 @@ int main(int argc, char **argv) {
     }
   }
 
+  cobalt_watchdog_mark_phase("expose-pids");
+
   if (config->flextop.enabled) {
     flextop_init(config);
   }
 
-  g_autoptr(CobaltLauncher) launcher = setup_launcher(config, host);
+  cobalt_watchdog_mark_phase("flextop");
 
-  if (config->application.first_run_urls && *config->application.first_run_urls) {
+  if (options.preload && !should_preload(config, host)) {
+    save_state(state);
+    return 0;
+  }
+
+  g_autofree char *profile_dir = NULL;
+  g_autoptr(CobaltLauncher) launcher =
+      setup_launcher(config, host, state, &options, under_pressure, &profile_dir);
+  cobalt_watchdog_mark_phase("launcher");
+
+  if (options.preload) {
+    setup_preload(config, launcher);
+  }
+
+  // Neither automation nor a preload ever shows the first run pages, so the stamp
+  // is left for the next interactive launch.
+  if (!options.headless && !options.preload && config->application.first_run_urls &&
+      *config->application.first_run_urls) {
     g_autoptr(GFile) stamp_file = get_stamp_file(config, COBALT_STAMP_FIRST_RUN);
     if (!g_file_query_exists(stamp_file, NULL)) {
       cobalt_launcher_add_argv(launcher, config->application.first_run_urls);
@@ -384,7 +1153,42 @@ int main(int argc, char **argv) {
     }
   }
 
-  cobalt_launcher_add_argv(launcher, argv + 1);
+  cobalt_launcher_add_argv(launcher, forwarded_argv);
+
+  save_state(state);
+
+  if (options.pool_size != 0) {
+    return run_pool(config, launcher, &options);
+  }
+
+  // A launch that only hands off to the running instance exits right away, so
+  // there's nothing to supervise.
+  if ((options.supervise || config->supervisor.enabled) &&
+      (profile_dir == NULL || !cobalt_profile_is_running(profile_dir))) {
+    if (!cobalt_launcher_prepare(launcher, &error)) {
+      g_critical("Failed to prepare launch: %s", error->message);
+      return 1;
+    }
+
+    SupervisorRestart restart = {
+        .config = config,
+        .host = host,
+        .profile_dir = profile_dir,
+    };
+    return cobalt_supervisor_run(config, launcher, profile_dir, prepare_restart,
+                                 &restart);
+  }
+
+  cobalt_watchdog_mark_phase("exec");
+
+  // Headless browsers never create the singleton socket the watchdog waits for.
+  if (config->watchdog.enabled && !options.headless) {
+    g_warn_if_fail(profile_dir);
+    if (!cobalt_watchdog_start(config, profile_dir, &error)) {
+      g_warning("Failed to start watchdog: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
 
   cobalt_launcher_exec(launcher, &error);
   g_critical("Failed to exec: %s", error->message);
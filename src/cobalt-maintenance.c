@@ -0,0 +1,506 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-maintenance.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-profile.h"
+#include "cobalt-sched.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sqlite3.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Like the profile RAM copy, this lives under XDG_RUNTIME_DIR/app/APP_ID so
+// every instance of the app sees the same locks.
+#define MAINTENANCE_ROOT_SUBDIR "cobalt-maintenance"
+// Held by the helper for as long as it exists, so only one is ever scheduled.
+#define MAINTENANCE_HELPER_LOCK "helper.lock"
+// Held by the helper only while it's actually touching the profile.
+#define MAINTENANCE_WORK_LOCK "work.lock"
+#define MAINTENANCE_LAUNCH_STAMP "launch-stamp"
+
+#define STATE_GROUP_MAINTENANCE "Maintenance"
+#define STATE_MAINTENANCE_LAST_RUN "LastRun"
+
+#define HELPER_POLL_INTERVAL 5
+#define HELPER_LAUNCH_GRACE_PERIOD (60 * G_TIME_SPAN_SECOND)
+#define HELPER_NICE 19
+
+// How long a launch waits for a running pass to notice it and stop. SQLite
+// checks in far more often than this, so it's only ever hit if the helper is
+// stuck in I/O.
+#define INTERRUPT_TIMEOUT (10 * G_TIME_SPAN_SECOND)
+#define INTERRUPT_POLL_INTERVAL (20 * G_TIME_SPAN_MILLISECOND)
+
+// Number of SQLite VM instructions between checks for whether to stop.
+#define SQLITE_PROGRESS_INTERVAL 10000
+// A database is only vacuumed if at least this percentage of it is free pages.
+#define SQLITE_VACUUM_MIN_FREE_PERCENT 10
+
+#define CRASH_REPORTS_SUBDIR "Crash Reports"
+#define CRASH_REPORTS_MAX_AGE (30 * G_TIME_SPAN_DAY)
+// Reports in new/ were never finished writing, so they're only kept long enough
+// for crashpad to pick them up.
+#define CRASH_REPORTS_NEW_MAX_AGE G_TIME_SPAN_DAY
+
+#define CODE_CACHE_SUBDIR "Code Cache"
+#define CODE_CACHE_INDEX "index"
+#define CODE_CACHE_INDEX_DIR "index-dir"
+
+static const char *CRASH_REPORTS_DIRS[] = {"completed", "pending", "attachments", NULL};
+
+typedef struct MaintenancePass {
+  const char *launch_stamp;
+  gint64 launch_stamp_mtime;
+  gint64 deadline;
+  gboolean stopped;
+} MaintenancePass;
+
+typedef struct CodeCacheEntry {
+  char *path;
+  guint64 size;
+  gint64 mtime;
+} CodeCacheEntry;
+
+static volatile sig_atomic_t helper_terminating = 0;
+
+static gint64 get_mtime(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0
+             ? st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000
+             : 0;
+}
+
+// A running pass checks the launch stamp and stops as soon as it changes, and a
+// pass only starts while holding the work lock after making sure the stamp is
+// old. Touching the stamp before waiting on the lock here means the two can
+// never end up working on the profile at the same time.
+static gboolean interrupt_running_pass(const char *root, GError **error) {
+  g_autofree char *stamp = g_build_filename(root, MAINTENANCE_LAUNCH_STAMP, NULL);
+  if (!g_file_set_contents(stamp, "", 0, error)) {
+    return FALSE;
+  }
+
+  g_autofree char *work_lock = g_build_filename(root, MAINTENANCE_WORK_LOCK, NULL);
+  gint64 deadline = g_get_monotonic_time() + INTERRUPT_TIMEOUT;
+  for (;;) {
+    g_autoptr(GError) local_error = NULL;
+    int fd = cobalt_util_open_lock(work_lock, LOCK_EX | LOCK_NB, &local_error);
+    if (fd != -1) {
+      close(fd);
+      return TRUE;
+    }
+
+    if (!g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      return FALSE;
+    }
+
+    if (g_get_monotonic_time() >= deadline) {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                  "Maintenance pass did not stop in time");
+      return FALSE;
+    }
+
+    g_usleep(INTERRUPT_POLL_INTERVAL);
+  }
+}
+
+static char *prepare_root(const char *app_id, GError **error) {
+  g_autofree char *root = g_build_filename(g_get_user_runtime_dir(), "app", app_id,
+                                           MAINTENANCE_ROOT_SUBDIR, NULL);
+  if (g_mkdir_with_parents(root, 0700) == -1) {
+    cobalt_util_set_error_from_errno(error, "create", root);
+    return NULL;
+  }
+
+  if (!interrupt_running_pass(root, error)) {
+    return NULL;
+  }
+
+  return g_steal_pointer(&root);
+}
+
+gboolean cobalt_maintenance_interrupt(const char *app_id, GError **error) {
+  g_autofree char *root = prepare_root(app_id, error);
+  return root != NULL;
+}
+
+gboolean cobalt_maintenance_schedule(CobaltConfig *config, CobaltState *state,
+                                     const char *app_id, const char *profile_dir,
+                                     gboolean postpone, GError **error) {
+  g_autofree char *root = prepare_root(app_id, error);
+  if (root == NULL) {
+    return FALSE;
+  }
+
+  gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  gint64 last_run = cobalt_state_get_int64(state, STATE_GROUP_MAINTENANCE,
+                                           STATE_MAINTENANCE_LAST_RUN, 0);
+  gint64 interval = (gint64)config->maintenance.interval * 24 * 60 * 60;
+  // Also covers the clock having gone backwards since the last run.
+  if (last_run <= now && now - last_run < interval) {
+    return TRUE;
+  }
+
+  if (postpone) {
+    g_debug("Postponing profile maintenance");
+    return TRUE;
+  }
+
+  g_autofree char *helper_lock = g_build_filename(root, MAINTENANCE_HELPER_LOCK, NULL);
+  g_autoptr(GError) local_error = NULL;
+  int helper_fd = cobalt_util_open_lock(helper_lock, LOCK_EX | LOCK_NB, &local_error);
+  if (helper_fd == -1) {
+    if (g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_debug("Profile maintenance is already scheduled");
+      return TRUE;
+    }
+
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return FALSE;
+  }
+
+  g_debug("Scheduling profile maintenance for after the browser exits");
+
+  g_autofree char *time_budget = g_strdup_printf("%u", config->maintenance.time_budget);
+  g_autofree char *code_cache_max_size =
+      g_strdup_printf("%" G_GUINT64_FORMAT, config->maintenance.code_cache_max_size_mb);
+  gboolean success = cobalt_helper_spawn_with_fd(COBALT_MAINTENANCE_HELPER_RUN, helper_fd,
+                                                 error, root, profile_dir, time_budget,
+                                                 code_cache_max_size, NULL);
+  close(helper_fd);
+
+  if (success) {
+    // Recorded when scheduling rather than when finishing, so a pass that
+    // keeps getting interrupted doesn't get rescheduled on every launch.
+    cobalt_state_set_int64(state, STATE_GROUP_MAINTENANCE, STATE_MAINTENANCE_LAST_RUN,
+                           now);
+  }
+
+  return success;
+}
+
+static gboolean pass_should_stop(MaintenancePass *pass) {
+  if (!pass->stopped &&
+      (helper_terminating || g_get_monotonic_time() >= pass->deadline ||
+       get_mtime(pass->launch_stamp) != pass->launch_stamp_mtime)) {
+    pass->stopped = TRUE;
+  }
+
+  return pass->stopped;
+}
+
+static int handle_sqlite_progress(void *user_data) {
+  return pass_should_stop(user_data) ? 1 : 0;
+}
+
+static gboolean set_error_from_sqlite(GError **error, sqlite3 *db, const char *action,
+                                      const char *path) {
+  g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to %s '%s': %s", action, path,
+              db != NULL ? sqlite3_errmsg(db) : "out of memory");
+  return FALSE;
+}
+
+static gboolean query_int64(sqlite3 *db, const char *sql, gint64 *value) {
+  sqlite3_stmt *stmt = NULL;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    return FALSE;
+  }
+
+  gboolean success = sqlite3_step(stmt) == SQLITE_ROW;
+  if (success) {
+    *value = sqlite3_column_int64(stmt, 0);
+  }
+
+  sqlite3_finalize(stmt);
+  return success;
+}
+
+static gboolean run_database_maintenance(sqlite3 *db, const char *path,
+                                         GError **error) {
+  // The browser isn't running, so nothing should be holding a lock; if
+  // something is anyway, leave the database alone rather than waiting.
+  sqlite3_busy_timeout(db, 0);
+
+  if (sqlite3_exec(db, "PRAGMA wal_checkpoint(TRUNCATE)", NULL, NULL, NULL) !=
+      SQLITE_OK) {
+    return set_error_from_sqlite(error, db, "checkpoint", path);
+  }
+
+  gint64 page_count = 0, freelist_count = 0;
+  if (!query_int64(db, "PRAGMA page_count", &page_count) ||
+      !query_int64(db, "PRAGMA freelist_count", &freelist_count)) {
+    return set_error_from_sqlite(error, db, "inspect", path);
+  }
+
+  // Vacuuming rewrites the entire file, which isn't worth it for the few pages
+  // that would be reclaimed from a mostly full database.
+  if (page_count == 0 ||
+      freelist_count * 100 / page_count < SQLITE_VACUUM_MIN_FREE_PERCENT) {
+    return TRUE;
+  }
+
+  g_debug("Vacuuming '%s' (%" G_GINT64_FORMAT " of %" G_GINT64_FORMAT " pages free)",
+          path, freelist_count, page_count);
+  if (sqlite3_exec(db, "VACUUM", NULL, NULL, NULL) != SQLITE_OK) {
+    return set_error_from_sqlite(error, db, "vacuum", path);
+  }
+
+  return TRUE;
+}
+
+static gboolean maintain_database(MaintenancePass *pass, const char *path,
+                                  GError **error) {
+  if (!g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+    return TRUE;
+  }
+
+  sqlite3 *db = NULL;
+  if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+    set_error_from_sqlite(error, db, "open", path);
+    sqlite3_close(db);
+    return FALSE;
+  }
+
+  sqlite3_progress_handler(db, SQLITE_PROGRESS_INTERVAL, handle_sqlite_progress, pass);
+
+  g_autoptr(GError) local_error = NULL;
+  gboolean success = run_database_maintenance(db, path, &local_error);
+  sqlite3_close(db);
+
+  // Being interrupted isn't a failure, SQLite already rolled back whatever was
+  // in progress.
+  if (!success && !pass->stopped) {
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void prune_old_entries(MaintenancePass *pass, const char *path, gint64 max_age) {
+  g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+
+  gint64 cutoff = g_get_real_time() - max_age;
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL && !pass_should_stop(pass)) {
+    g_autofree char *child = g_build_filename(path, name, NULL);
+    struct stat st;
+    if (lstat(child, &st) == -1 ||
+        st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000 >= cutoff) {
+      continue;
+    }
+
+    // Attachments are directories, one per report.
+    g_autoptr(GError) error = NULL;
+    if (!cobalt_util_remove_tree(child, &error)) {
+      g_warning("%s", error->message);
+    }
+  }
+}
+
+static void prune_crash_reports(MaintenancePass *pass, const char *profile_dir) {
+  g_autofree char *reports_dir =
+      g_build_filename(profile_dir, CRASH_REPORTS_SUBDIR, NULL);
+  for (const char **subdir = CRASH_REPORTS_DIRS; *subdir != NULL; subdir++) {
+    g_autofree char *path = g_build_filename(reports_dir, *subdir, NULL);
+    prune_old_entries(pass, path, CRASH_REPORTS_MAX_AGE);
+  }
+
+  g_autofree char *new_dir = g_build_filename(reports_dir, "new", NULL);
+  prune_old_entries(pass, new_dir, CRASH_REPORTS_NEW_MAX_AGE);
+}
+
+static void code_cache_entry_free(CodeCacheEntry *entry) {
+  g_free(entry->path);
+  g_free(entry);
+}
+
+static int compare_code_cache_entries(gconstpointer a, gconstpointer b) {
+  const CodeCacheEntry *entry_a = *(const CodeCacheEntry *const *)a;
+  const CodeCacheEntry *entry_b = *(const CodeCacheEntry *const *)b;
+  return entry_a->mtime < entry_b->mtime ? -1 : entry_a->mtime > entry_b->mtime;
+}
+
+// Code Cache holds one disk cache backend per kind of code (js, wasm, ...).
+static void collect_code_cache_entries(const char *code_cache_dir, GPtrArray *entries,
+                                       guint64 *total_size) {
+  g_autoptr(GDir) dir = g_dir_open(code_cache_dir, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+
+  const char *backend_name = NULL;
+  while ((backend_name = g_dir_read_name(dir)) != NULL) {
+    g_autofree char *backend_dir = g_build_filename(code_cache_dir, backend_name, NULL);
+    g_autoptr(GDir) backend = g_dir_open(backend_dir, 0, NULL);
+    if (backend == NULL) {
+      continue;
+    }
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(backend)) != NULL) {
+      if (g_str_equal(name, CODE_CACHE_INDEX) ||
+          g_str_equal(name, CODE_CACHE_INDEX_DIR)) {
+        continue;
+      }
+
+      g_autofree char *path = g_build_filename(backend_dir, name, NULL);
+      struct stat st;
+      if (lstat(path, &st) == -1 || !S_ISREG(st.st_mode)) {
+        continue;
+      }
+
+      CodeCacheEntry *entry = g_new0(CodeCacheEntry, 1);
+      entry->path = g_steal_pointer(&path);
+      entry->size = st.st_size;
+      entry->mtime = st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+      g_ptr_array_add(entries, entry);
+      *total_size += entry->size;
+    }
+  }
+}
+
+// Removes the least recently written entries until all code caches together
+// fit in max_size. The disk cache notices its directory changed after its
+// index was written and rebuilds the index on the next start, so the index
+// files themselves are left alone.
+static void trim_code_caches(MaintenancePass *pass, GPtrArray *profiles,
+                             guint64 max_size) {
+  g_autoptr(GPtrArray) entries =
+      g_ptr_array_new_with_free_func((GDestroyNotify)code_cache_entry_free);
+  guint64 total_size = 0;
+
+  for (guint i = 0; i < profiles->len; i++) {
+    g_autofree char *code_cache_dir =
+        g_build_filename(profiles->pdata[i], CODE_CACHE_SUBDIR, NULL);
+    collect_code_cache_entries(code_cache_dir, entries, &total_size);
+  }
+
+  if (total_size <= max_size) {
+    return;
+  }
+
+  g_debug("Trimming code caches from %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT
+          " bytes",
+          total_size, max_size);
+
+  g_ptr_array_sort(entries, compare_code_cache_entries);
+  for (guint i = 0; i < entries->len && total_size > max_size && !pass_should_stop(pass);
+       i++) {
+    CodeCacheEntry *entry = entries->pdata[i];
+    if (unlink(entry->path) == -1 && errno != ENOENT) {
+      int saved_errno = errno;
+      g_warning("Failed to remove '%s': %s", entry->path, g_strerror(saved_errno));
+      continue;
+    }
+
+    total_size -= entry->size;
+  }
+}
+
+static void run_pass(MaintenancePass *pass, const char *profile_dir,
+                     guint64 code_cache_max_size) {
+  gint64 start = g_get_monotonic_time();
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+
+  // The cheapest work goes first, so it still gets done when the budget runs
+  // out during a large vacuum.
+  prune_crash_reports(pass, profile_dir);
+  trim_code_caches(pass, profiles, code_cache_max_size);
+
+  for (guint i = 0; i < profiles->len && !pass_should_stop(pass); i++) {
+    for (const char *const *database = cobalt_profile_get_databases();
+         *database != NULL && !pass_should_stop(pass); database++) {
+      g_autofree char *path = g_build_filename(profiles->pdata[i], *database, NULL);
+      g_autoptr(GError) error = NULL;
+      if (!maintain_database(pass, path, &error)) {
+        g_warning("%s", error->message);
+      }
+    }
+  }
+
+  g_debug("Profile maintenance %s after %" G_GINT64_FORMAT "ms",
+          pass->stopped ? "stopped" : "finished",
+          (g_get_monotonic_time() - start) / G_TIME_SPAN_MILLISECOND);
+}
+
+static gboolean browser_has_exited(const char *launch_stamp, const char *profile_dir) {
+  return g_get_real_time() - get_mtime(launch_stamp) > HELPER_LAUNCH_GRACE_PERIOD &&
+         !cobalt_profile_is_running(profile_dir);
+}
+
+static void helper_handle_signal(int signum) { helper_terminating = 1; }
+
+int cobalt_maintenance_helper_run(int argc, char **argv) {
+  if (argc != 4) {
+    g_printerr("usage: " COBALT_MAINTENANCE_HELPER_RUN " ROOT PROFILE-DIR TIME-BUDGET "
+               "CODE-CACHE-MAX-SIZE\n");
+    return 1;
+  }
+
+  const char *root = argv[0];
+  const char *profile_dir = argv[1];
+  gint64 time_budget = g_ascii_strtoull(argv[2], NULL, 10) * G_TIME_SPAN_SECOND;
+  guint64 code_cache_max_size = g_ascii_strtoull(argv[3], NULL, 10) * 1024 * 1024;
+
+  g_autofree char *launch_stamp = g_build_filename(root, MAINTENANCE_LAUNCH_STAMP, NULL);
+  g_autofree char *work_lock = g_build_filename(root, MAINTENANCE_WORK_LOCK, NULL);
+
+  struct sigaction action = {.sa_handler = helper_handle_signal};
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+
+  setpriority(PRIO_PROCESS, 0, HELPER_NICE);
+  cobalt_sched_set_io_priority(0, COBALT_SCHED_IO_CLASS_IDLE, 0, NULL);
+
+  while (!helper_terminating) {
+    // Not g_usleep, which would restart after being interrupted by a signal.
+    sleep(HELPER_POLL_INTERVAL);
+
+    if (helper_terminating || !browser_has_exited(launch_stamp, profile_dir)) {
+      continue;
+    }
+
+    g_autoptr(GError) error = NULL;
+    int work_fd = cobalt_util_open_lock(work_lock, LOCK_EX | LOCK_NB, &error);
+    if (work_fd == -1) {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+        g_warning("%s", error->message);
+        return 1;
+      }
+
+      continue;
+    }
+
+    // A launch may have slipped in before the lock was taken.
+    MaintenancePass pass = {
+        .launch_stamp = launch_stamp,
+        .launch_stamp_mtime = get_mtime(launch_stamp),
+        .deadline = g_get_monotonic_time() + time_budget,
+    };
+    if (!browser_has_exited(launch_stamp, profile_dir)) {
+      close(work_fd);
+      continue;
+    }
+
+    run_pass(&pass, profile_dir, code_cache_max_size);
+    close(work_fd);
+    break;
+  }
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+#include "cobalt-state.h"
+
+#include <glib.h>
+
+#define COBALT_MAINTENANCE_HELPER_RUN "profile-maintenance"
+
+// Stops any maintenance pass that is still working on the profile at
+// profile_dir, and if [Maintenance] is due and postpone is FALSE, starts a
+// helper that runs the next one once the browser has exited again.
+gboolean cobalt_maintenance_schedule(CobaltConfig *config, CobaltState *state,
+                                     const char *app_id, const char *profile_dir,
+                                     gboolean postpone, GError **error);
+
+// Stops any maintenance pass that is still working on the profile, and keeps a
+// scheduled one from starting until the browser has exited again. Meant for
+// starting the browser again without going through cobalt_maintenance_schedule.
+gboolean cobalt_maintenance_interrupt(const char *app_id, GError **error);
+
+int cobalt_maintenance_helper_run(int argc, char **argv);
@@ -0,0 +1,186 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-memory.h"
+
+#include "cobalt-proc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PROC_PATH "/proc"
+
+#define TOTAL_TYPE "total"
+
+typedef struct MemoryUsage {
+  guint processes;
+  // All in bytes.
+  guint64 rss;
+  guint64 pss;
+  guint64 swap;
+} MemoryUsage;
+
+static void add_usage(MemoryUsage *total, const MemoryUsage *usage) {
+  total->processes += usage->processes;
+  total->rss += usage->rss;
+  total->pss += usage->pss;
+  total->swap += usage->swap;
+}
+
+static gboolean parse_kib_field(const char *line, const char *field, guint64 *value) {
+  if (!g_str_has_prefix(line, field) || line[strlen(field)] != ':') {
+    return FALSE;
+  }
+
+  // Every line looks like "Pss:    1234 kB".
+  *value = g_ascii_strtoull(line + strlen(field) + 1, NULL, 10) * 1024;
+  return TRUE;
+}
+
+// smaps_rollup has the totals of smaps, without having to walk every mapping,
+// and PSS is the only figure that doesn't count pages shared between the
+// browser's processes more than once.
+static gboolean read_usage(pid_t pid, MemoryUsage *usage) {
+  g_autofree char *path = g_strdup_printf(PROC_PATH "/%d/smaps_rollup", pid);
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return FALSE;
+  }
+
+  *usage = (MemoryUsage){.processes = 1};
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (char **line = lines; *line != NULL; line++) {
+    if (!parse_kib_field(*line, "Rss", &usage->rss) &&
+        !parse_kib_field(*line, "Pss", &usage->pss)) {
+      parse_kib_field(*line, "Swap", &usage->swap);
+    }
+  }
+
+  return TRUE;
+}
+
+// Maps process types to MemoryUsage*.
+static GHashTable *collect_usage(GArray *pids) {
+  GHashTable *usage_by_type =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  for (guint i = 0; i < pids->len; i++) {
+    pid_t pid = g_array_index(pids, pid_t, i);
+
+    // Processes can exit at any point in between.
+    g_autofree char *type = cobalt_proc_get_chromium_type(pid);
+    MemoryUsage usage;
+    if (type == NULL || !read_usage(pid, &usage)) {
+      continue;
+    }
+
+    MemoryUsage *type_usage = g_hash_table_lookup(usage_by_type, type);
+    if (type_usage == NULL) {
+      type_usage = g_new0(MemoryUsage, 1);
+      g_hash_table_insert(usage_by_type, g_steal_pointer(&type), type_usage);
+    }
+
+    add_usage(type_usage, &usage);
+  }
+
+  return usage_by_type;
+}
+
+static int compare_types(gconstpointer a, gconstpointer b) {
+  return g_strcmp0(*(const char **)a, *(const char **)b);
+}
+
+static double to_mib(guint64 bytes) {
+  return bytes / 1024.0 / 1024.0;
+}
+
+static void append_table_row(GString *report, const char *type,
+                             const MemoryUsage *usage) {
+  g_string_append_printf(report, "%-20s %9u %12.1f %12.1f %12.1f\n", type,
+                         usage->processes, to_mib(usage->rss), to_mib(usage->pss),
+                         to_mib(usage->swap));
+}
+
+static void append_json_usage(GString *report, const char *type,
+                              const MemoryUsage *usage) {
+  // Chromium's process types never need escaping.
+  g_string_append_printf(report,
+                         "\"%s\": {\"processes\": %u, \"rss\": %" G_GUINT64_FORMAT
+                         ", \"pss\": %" G_GUINT64_FORMAT ", \"swap\": %" G_GUINT64_FORMAT
+                         "}",
+                         type, usage->processes, usage->rss, usage->pss, usage->swap);
+}
+
+static GString *format_report(GHashTable *usage_by_type, CobaltMemoryReportFormat format,
+                              GDateTime *time) {
+  g_autofree char *timestamp = g_date_time_format_iso8601(time);
+
+  g_autoptr(GPtrArray) types = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer type = NULL;
+  g_hash_table_iter_init(&iter, usage_by_type);
+  while (g_hash_table_iter_next(&iter, &type, NULL)) {
+    g_ptr_array_add(types, type);
+  }
+  g_ptr_array_sort(types, compare_types);
+
+  MemoryUsage total = {0};
+  GString *report = g_string_new(NULL);
+
+  if (format == COBALT_MEMORY_REPORT_FORMAT_JSON) {
+    // One object per line, so a series of reports can be read line by line.
+    g_string_append_printf(report, "{\"timestamp\": \"%s\", \"types\": {", timestamp);
+    for (guint i = 0; i < types->len; i++) {
+      MemoryUsage *usage = g_hash_table_lookup(usage_by_type, types->pdata[i]);
+      add_usage(&total, usage);
+
+      if (i != 0) {
+        g_string_append(report, ", ");
+      }
+      append_json_usage(report, types->pdata[i], usage);
+    }
+    g_string_append(report, "}, ");
+    append_json_usage(report, TOTAL_TYPE, &total);
+    g_string_append(report, "}\n");
+  } else {
+    g_string_append_printf(report, "%s\n%-20s %9s %12s %12s %12s\n", timestamp, "TYPE",
+                           "PROCESSES", "RSS (MiB)", "PSS (MiB)", "SWAP (MiB)");
+    for (guint i = 0; i < types->len; i++) {
+      MemoryUsage *usage = g_hash_table_lookup(usage_by_type, types->pdata[i]);
+      add_usage(&total, usage);
+      append_table_row(report, types->pdata[i], usage);
+    }
+    append_table_row(report, TOTAL_TYPE, &total);
+    g_string_append_c(report, '\n');
+  }
+
+  return report;
+}
+
+int cobalt_memory_report_run(const char *entry_point, CobaltMemoryReportFormat format,
+                             guint interval, guint count) {
+  if (interval == 0) {
+    count = 1;
+  }
+
+  for (guint i = 0; count == 0 || i < count; i++) {
+    if (i != 0) {
+      g_usleep(interval * G_USEC_PER_SEC);
+    }
+
+    g_autoptr(GDateTime) now = g_date_time_new_now_local();
+    g_autoptr(GArray) pids = cobalt_proc_list_by_exe(entry_point);
+    g_autoptr(GHashTable) usage_by_type = collect_usage(pids);
+    if (count == 1 && g_hash_table_size(usage_by_type) == 0) {
+      g_printerr("No running processes of '%s' found\n", entry_point);
+      return 1;
+    }
+
+    g_autoptr(GString) report = format_report(usage_by_type, format, now);
+    fputs(report->str, stdout);
+    fflush(stdout);
+  }
+
+  return 0;
+}
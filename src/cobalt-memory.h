@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+typedef enum {
+  COBALT_MEMORY_REPORT_FORMAT_TABLE,
+  COBALT_MEMORY_REPORT_FORMAT_JSON,
+} CobaltMemoryReportFormat;
+
+// Prints the memory use of every visible process running entry_point, summed up
+// per Chromium process type. If interval (in seconds) is non-zero, a new report
+// is printed every interval seconds, count times, or forever if count is 0.
+// Returns the exit status to exit cobalt with.
+int cobalt_memory_report_run(const char *entry_point, CobaltMemoryReportFormat format,
+                             guint interval, guint count);
@@ -0,0 +1,237 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-pool.h"
+
+#include "cobalt-template.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <gio/gio.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define INSTANCE_DIR_FORMAT "instance-%u"
+
+typedef struct PoolInstance {
+  GPid pid;
+  guint16 port;
+  char *user_data_dir;
+} PoolInstance;
+
+// Shared with the signal handler, which forwards to every instance still
+// running.
+static volatile sig_atomic_t stop_signal = 0;
+static PoolInstance *instances = NULL;
+static guint instance_count = 0;
+
+static void handle_stop_signal(int signum) {
+  stop_signal = signum;
+  for (guint i = 0; i < instance_count; i++) {
+    if (instances[i].pid > 0) {
+      kill(instances[i].pid, signum);
+    }
+  }
+}
+
+// Binds a socket to a port the kernel picks, and returns the socket so the port
+// stays reserved until it's closed.
+static int reserve_port(guint16 *port, GError **error) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create socket: %s", g_strerror(saved_errno));
+    return -1;
+  }
+
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+      .sin_port = 0,
+  };
+  socklen_t addr_len = sizeof(addr);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      getsockname(fd, (struct sockaddr *)&addr, &addr_len) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to reserve a port: %s", g_strerror(saved_errno));
+    close(fd);
+    return -1;
+  }
+
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+static void append_json_string(GString *json, const char *value) {
+  g_string_append_c(json, '"');
+  for (const char *c = value; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      g_string_append_printf(json, "\\%c", *c);
+    } else if ((guchar)*c < 0x20) {
+      g_string_append_printf(json, "\\u%04x", (guchar)*c);
+    } else {
+      g_string_append_c(json, *c);
+    }
+  }
+  g_string_append_c(json, '"');
+}
+
+static gboolean write_manifest(const char *manifest_path, GError **error) {
+  g_autoptr(GString) json = g_string_new("{\n  \"instances\": [");
+  for (guint i = 0; i < instance_count; i++) {
+    g_string_append_printf(json,
+                           "%s\n    {\"pid\": %d, \"port\": %u, \"user_data_dir\": ",
+                           i == 0 ? "" : ",", instances[i].pid, instances[i].port);
+    append_json_string(json, instances[i].user_data_dir);
+    g_string_append_c(json, '}');
+  }
+  g_string_append(json, "\n  ]\n}\n");
+
+  return g_file_set_contents(manifest_path, json->str, json->len, error);
+}
+
+// The instance's port is released right before it's spawned, which closes
+// port_fd.
+static gboolean spawn_instance(CobaltLauncher *launcher, const char *pool_dir,
+                               const char *profile_template, guint index,
+                               PoolInstance *instance, int *port_fd, GError **error) {
+  g_autofree char *instance_name = g_strdup_printf(INSTANCE_DIR_FORMAT, index);
+  instance->user_data_dir = g_build_filename(pool_dir, instance_name, NULL);
+  if (profile_template != NULL) {
+    if (!cobalt_template_clone(profile_template, instance->user_data_dir, error)) {
+      return FALSE;
+    }
+  } else if (g_mkdir_with_parents(instance->user_data_dir, 0700) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", instance->user_data_dir,
+                g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  g_autofree char *user_data_dir_flag =
+      g_strdup_printf("--user-data-dir=%s", instance->user_data_dir);
+  g_autofree char *port_flag =
+      g_strdup_printf("--remote-debugging-port=%u", instance->port);
+  const char *extra_args[] = {user_data_dir_flag, port_flag, NULL};
+
+  close(*port_fd);
+  *port_fd = -1;
+
+  instance->pid = cobalt_launcher_spawn(launcher, extra_args, error);
+  if (instance->pid == 0) {
+    return FALSE;
+  }
+
+  g_debug("Started instance %u with pid %d on port %u", index, instance->pid,
+          instance->port);
+  return TRUE;
+}
+
+// Reaps every instance, returning the first failing exit status, if any.
+static int wait_for_instances(void) {
+  int exit_status = 0;
+  for (guint remaining = instance_count; remaining > 0;) {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      g_warning("Failed to wait for instances: %s", g_strerror(errno));
+      return 1;
+    }
+
+    for (guint i = 0; i < instance_count; i++) {
+      if (instances[i].pid != pid) {
+        continue;
+      }
+
+      instances[i].pid = 0;
+      remaining--;
+
+      int instance_status =
+          WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+      if (instance_status != 0) {
+        g_warning("Instance %u exited with status %d", i, instance_status);
+        if (exit_status == 0) {
+          exit_status = instance_status;
+        }
+      }
+    }
+  }
+
+  return exit_status;
+}
+
+int cobalt_pool_run(CobaltLauncher *launcher, guint size, const char *pool_dir,
+                    const char *manifest_path, const char *profile_template) {
+  g_autoptr(GError) error = NULL;
+
+  instances = g_new0(PoolInstance, size);
+  instance_count = size;
+
+  struct sigaction action = {.sa_handler = handle_stop_signal};
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+
+  // All ports are reserved up front, so none of them can be handed out twice,
+  // and each one is only released right before its instance is spawned, so the
+  // instance can bind it.
+  g_autofree int *port_fds = g_new(int, size);
+  guint reserved = 0;
+  for (; reserved < size; reserved++) {
+    port_fds[reserved] = reserve_port(&instances[reserved].port, &error);
+    if (port_fds[reserved] == -1) {
+      break;
+    }
+  }
+
+  guint started = 0;
+  for (; error == NULL && started < size && !stop_signal; started++) {
+    if (!spawn_instance(launcher, pool_dir, profile_template, started,
+                        &instances[started], &port_fds[started], &error)) {
+      break;
+    }
+  }
+
+  for (guint i = started; i < reserved; i++) {
+    if (port_fds[i] != -1) {
+      close(port_fds[i]);
+    }
+  }
+
+  // Only the instances that actually started are waited for.
+  instance_count = started;
+
+  int exit_status = 0;
+  if (error != NULL) {
+    g_critical("Failed to start instance %u: %s", started, error->message);
+    handle_stop_signal(SIGTERM);
+    exit_status = 1;
+  } else if (!write_manifest(manifest_path, &error)) {
+    g_critical("Failed to write manifest: %s", error->message);
+    handle_stop_signal(SIGTERM);
+    exit_status = 1;
+  } else {
+    g_debug("Started %u instances, manifest is at '%s'", started, manifest_path);
+  }
+
+  int instances_status = wait_for_instances();
+
+  for (guint i = 0; i < size; i++) {
+    g_free(instances[i].user_data_dir);
+  }
+  g_clear_pointer(&instances, g_free);
+  instance_count = 0;
+
+  return exit_status != 0 ? exit_status : instances_status;
+}
@@ -0,0 +1,18 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-launcher.h"
+
+#include <glib.h>
+
+// Starts size instances of the browser from an already prepared launcher, each
+// with its own user data directory under pool_dir and its own remote debugging
+// port. New user data directories are created from profile_template, unless
+// it's NULL. Once all of them are running, a JSON manifest describing them is
+// written to manifest_path. Returns the exit status to exit cobalt with once
+// all instances have exited.
+int cobalt_pool_run(CobaltLauncher *launcher, guint size, const char *pool_dir,
+                    const char *manifest_path, const char *profile_template);
@@ -0,0 +1,81 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-power.h"
+
+#include "cobalt-util.h"
+
+#define SYSFS_POWER_SUPPLY_DIR "class/power_supply"
+#define SYSFS_PLATFORM_PROFILE "firmware/acpi/platform_profile"
+
+#define POWER_SUPPLY_TYPE_BATTERY "Battery"
+// Batteries of e.g. wireless mice have this scope, and say nothing about the
+// system itself.
+#define POWER_SUPPLY_SCOPE_DEVICE "Device"
+
+static const char *LOW_POWER_PROFILES[] = {"low-power", "quiet", "cool", NULL};
+
+static char *read_attribute(const char *supply_dir, const char *name) {
+  g_autofree char *path = g_build_filename(supply_dir, name, NULL);
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return NULL;
+  }
+
+  return g_strdup(g_strstrip(contents));
+}
+
+void cobalt_power_get_state(CobaltPowerState *state) {
+  *state = (CobaltPowerState){.battery_percent = -1};
+
+  gboolean has_battery = FALSE;
+  gboolean external_power = FALSE;
+
+  g_autofree char *supplies_path = cobalt_util_get_sysfs_path(SYSFS_POWER_SUPPLY_DIR);
+  g_autoptr(GDir) supplies = g_dir_open(supplies_path, 0, NULL);
+  const char *name = NULL;
+  while (supplies != NULL && (name = g_dir_read_name(supplies)) != NULL) {
+    g_autofree char *supply_dir = g_build_filename(supplies_path, name, NULL);
+    g_autofree char *type = read_attribute(supply_dir, "type");
+    g_autofree char *scope = read_attribute(supply_dir, "scope");
+    if (type == NULL || g_strcmp0(scope, POWER_SUPPLY_SCOPE_DEVICE) == 0) {
+      continue;
+    }
+
+    if (g_str_equal(type, POWER_SUPPLY_TYPE_BATTERY)) {
+      has_battery = TRUE;
+
+      g_autofree char *capacity_path = g_build_filename(supply_dir, "capacity", NULL);
+      guint64 capacity = 0;
+      if (cobalt_util_read_uint64_file(capacity_path, &capacity, NULL) &&
+          capacity <= 100 &&
+          (state->battery_percent == -1 || capacity < state->battery_percent)) {
+        state->battery_percent = capacity;
+      }
+    } else {
+      // Mains, USB, and so on.
+      g_autofree char *online = read_attribute(supply_dir, "online");
+      if (g_strcmp0(online, "1") == 0) {
+        external_power = TRUE;
+      }
+    }
+  }
+
+  state->on_battery = has_battery && !external_power;
+
+  g_autofree char *profile_path = cobalt_util_get_sysfs_path(SYSFS_PLATFORM_PROFILE);
+  g_autofree char *profile = NULL;
+  if (g_file_get_contents(profile_path, &profile, NULL, NULL)) {
+    state->platform_profile = g_strdup(g_strstrip(profile));
+  }
+}
+
+gboolean cobalt_power_state_is_low_power_profile(const CobaltPowerState *state) {
+  return state->platform_profile != NULL &&
+         g_strv_contains(LOW_POWER_PROFILES, state->platform_profile);
+}
+
+void cobalt_power_state_clear(CobaltPowerState *state) {
+  g_clear_pointer(&state->platform_profile, g_free);
+}
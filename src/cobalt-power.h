@@ -0,0 +1,31 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+typedef struct CobaltPowerState CobaltPowerState;
+
+struct CobaltPowerState {
+  // TRUE if the system has a battery and isn't connected to external power.
+  gboolean on_battery;
+  // The lowest charge of any system battery in percent, or -1 if unknown.
+  int battery_percent;
+  // The active ACPI platform profile, e.g. "low-power", or NULL if the platform
+  // doesn't have any.
+  char *platform_profile;
+};
+
+// Reads the power state from sysfs, which can be relocated for testing with
+// COBALT_SYSFS_OVERRIDE. Missing information is reported as unknown rather
+// than as an error.
+void cobalt_power_get_state(CobaltPowerState *state);
+
+// Whether the platform profile asks for saving power over performance.
+gboolean cobalt_power_state_is_low_power_profile(const CobaltPowerState *state);
+
+void cobalt_power_state_clear(CobaltPowerState *state);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(CobaltPowerState, cobalt_power_state_clear)
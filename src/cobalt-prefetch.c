@@ -0,0 +1,117 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-prefetch.h"
+
+#include "cobalt-fs.h"
+#include "cobalt-profile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOCAL_STATE_FILE "Local State"
+#define SESSIONS_SUBDIR "Sessions"
+
+// In the order the browser reads them, so the earliest ones still make it in if
+// the budget runs out.
+static const char *PROFILE_FILES[] = {
+    "Preferences", "Secure Preferences", "History", "Cookies",
+    // Newer versions moved the cookies here.
+    "Network/Cookies", "Web Data", NULL,
+};
+
+typedef struct Prefetch {
+  guint64 remaining;
+  guint64 max_file_size;
+} Prefetch;
+
+static void prefetch_file(Prefetch *prefetch, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    if (errno != ENOENT) {
+      g_debug("Failed to open '%s' for prefetching: %s", path, g_strerror(errno));
+    }
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return;
+  }
+
+  guint64 size = st.st_size;
+  if (size > prefetch->max_file_size) {
+    g_debug("Not prefetching '%s', it's too large", path);
+  } else if (size > prefetch->remaining) {
+    g_debug("Not prefetching '%s', the budget is exhausted", path);
+  } else {
+    // This only queues the reads, which keep going after the file is closed.
+    int ret = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    if (ret != 0) {
+      g_debug("Failed to prefetch '%s': %s", path, g_strerror(ret));
+    } else {
+      prefetch->remaining -= size;
+    }
+  }
+
+  close(fd);
+}
+
+static void prefetch_sessions(Prefetch *prefetch, const char *profile) {
+  g_autofree char *sessions_dir = g_build_filename(profile, SESSIONS_SUBDIR, NULL);
+  g_autoptr(GDir) dir = g_dir_open(sessions_dir, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    g_autofree char *path = g_build_filename(sessions_dir, name, NULL);
+    prefetch_file(prefetch, path);
+  }
+}
+
+static void prefetch_profile(Prefetch *prefetch, const char *profile) {
+  for (const char **file = PROFILE_FILES; *file != NULL; file++) {
+    g_autofree char *path = g_build_filename(profile, *file, NULL);
+    prefetch_file(prefetch, path);
+  }
+
+  prefetch_sessions(prefetch, profile);
+}
+
+gboolean cobalt_prefetch_profile(CobaltConfig *config, const char *profile_dir,
+                                 GError **error) {
+  CobaltFsType type = COBALT_FS_TYPE_OTHER;
+  if (!cobalt_fs_detect(profile_dir, &type, error)) {
+    return FALSE;
+  }
+
+  // Reading ahead over the network only competes with the reads the browser
+  // actually does.
+  if (cobalt_fs_type_is_network(type)) {
+    g_debug("Not prefetching profile on %s", cobalt_fs_type_to_string(type));
+    return TRUE;
+  }
+
+  Prefetch prefetch = {
+      .remaining = config->prefetch.budget_mb * 1024 * 1024,
+      .max_file_size = config->prefetch.max_file_size_mb * 1024 * 1024,
+  };
+
+  g_autofree char *local_state = g_build_filename(profile_dir, LOCAL_STATE_FILE, NULL);
+  prefetch_file(&prefetch, local_state);
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    prefetch_profile(&prefetch, profiles->pdata[i]);
+  }
+
+  g_debug("Prefetched %" G_GUINT64_FORMAT " bytes of the profile",
+          config->prefetch.budget_mb * 1024 * 1024 - prefetch.remaining);
+  return TRUE;
+}
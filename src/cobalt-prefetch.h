@@ -0,0 +1,16 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+
+#include <glib.h>
+
+// Asks the kernel to start reading the files the browser needs first from the
+// profile at profile_dir into the page cache, as configured by [Prefetch]. This
+// doesn't wait for any of the reads, so the rest of the launch overlaps with
+// them. Profiles on network filesystems are skipped.
+gboolean cobalt_prefetch_profile(CobaltConfig *config, const char *profile_dir,
+                                 GError **error);
@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-pressure.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#define PRESSURE_DIR "/proc/pressure"
+
+// The first line of every file looks like:
+// "some avg10=1.23 avg60=0.45 avg300=0.06 total=123456"
+#define PRESSURE_SOME_PREFIX "some "
+#define PRESSURE_AVG10_PREFIX "avg10="
+
+const char *cobalt_pressure_resource_to_string(CobaltPressureResource resource) {
+  switch (resource) {
+  case COBALT_PRESSURE_CPU:
+    return "cpu";
+  case COBALT_PRESSURE_MEMORY:
+    return "memory";
+  case COBALT_PRESSURE_IO:
+    return "io";
+  }
+
+  g_warn_if_reached();
+  return NULL;
+}
+
+gboolean cobalt_pressure_read(CobaltPressureResource resource, double *some_avg10,
+                              GError **error) {
+  g_autofree char *path =
+      g_build_filename(PRESSURE_DIR, cobalt_pressure_resource_to_string(resource), NULL);
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, error)) {
+    return FALSE;
+  }
+
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (char **line = lines; *line != NULL; line++) {
+    if (!g_str_has_prefix(*line, PRESSURE_SOME_PREFIX)) {
+      continue;
+    }
+
+    g_auto(GStrv) fields = g_strsplit(*line + strlen(PRESSURE_SOME_PREFIX), " ", -1);
+    for (char **field = fields; *field != NULL; field++) {
+      if (!g_str_has_prefix(*field, PRESSURE_AVG10_PREFIX)) {
+        continue;
+      }
+
+      const char *value = *field + strlen(PRESSURE_AVG10_PREFIX);
+      char *end = NULL;
+      *some_avg10 = g_ascii_strtod(value, &end);
+      if (end == value) {
+        break;
+      }
+
+      return TRUE;
+    }
+  }
+
+  g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Failed to parse '%s'", path);
+  return FALSE;
+}
@@ -0,0 +1,21 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+typedef enum {
+  COBALT_PRESSURE_CPU,
+  COBALT_PRESSURE_MEMORY,
+  COBALT_PRESSURE_IO,
+} CobaltPressureResource;
+
+const char *cobalt_pressure_resource_to_string(CobaltPressureResource resource);
+
+// Reads the share of time, in percent, that at least one task was stalled on
+// the resource over the last 10 seconds, from /proc/pressure. Fails with
+// G_IO_ERROR_NOT_FOUND if the kernel doesn't support PSI.
+gboolean cobalt_pressure_read(CobaltPressureResource resource, double *some_avg10,
+                              GError **error);
@@ -0,0 +1,165 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-proc.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#define PROC_PATH "/proc"
+
+#define CHROMIUM_TYPE_SWITCH "--type="
+#define CHROMIUM_TYPE_BROWSER "browser"
+
+gboolean cobalt_proc_is_alive(pid_t pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static gboolean parse_pid(const char *name, pid_t *pid) {
+  guint64 value = 0;
+  if (!g_ascii_string_to_unsigned(name, 10, 1, G_MAXINT, &value, NULL)) {
+    return FALSE;
+  }
+
+  *pid = value;
+  return TRUE;
+}
+
+static gboolean read_parent_pid(pid_t pid, pid_t *ppid) {
+  g_autofree char *stat_path = g_strdup_printf(PROC_PATH "/%d/stat", pid);
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(stat_path, &contents, NULL, NULL)) {
+    return FALSE;
+  }
+
+  // The command name may contain spaces and parentheses, so skip past the
+  // last ')' before splitting: "PID (COMM) STATE PPID ...".
+  const char *fields = strrchr(contents, ')');
+  if (fields == NULL) {
+    return FALSE;
+  }
+
+  char state = 0;
+  int parent = 0;
+  if (sscanf(fields + 1, " %c %d", &state, &parent) != 2) {
+    return FALSE;
+  }
+
+  *ppid = parent;
+  return TRUE;
+}
+
+GArray *cobalt_proc_list_tree(pid_t root) {
+  g_autoptr(GArray) tree = g_array_new(FALSE, FALSE, sizeof(pid_t));
+  g_autoptr(GHashTable) children = g_hash_table_new_full(
+      g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_array_unref);
+
+  g_autoptr(GDir) dir = g_dir_open(PROC_PATH, 0, NULL);
+  if (dir == NULL) {
+    return g_steal_pointer(&tree);
+  }
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    pid_t pid = 0, ppid = 0;
+    if (!parse_pid(name, &pid) || !read_parent_pid(pid, &ppid)) {
+      continue;
+    }
+
+    GArray *siblings = g_hash_table_lookup(children, GINT_TO_POINTER(ppid));
+    if (siblings == NULL) {
+      siblings = g_array_new(FALSE, FALSE, sizeof(pid_t));
+      g_hash_table_insert(children, GINT_TO_POINTER(ppid), siblings);
+    }
+
+    g_array_append_val(siblings, pid);
+  }
+
+  if (!cobalt_proc_is_alive(root)) {
+    return g_steal_pointer(&tree);
+  }
+
+  // Breadth-first walk, using the result array itself as the queue.
+  g_array_append_val(tree, root);
+  for (guint i = 0; i < tree->len; i++) {
+    pid_t pid = g_array_index(tree, pid_t, i);
+    GArray *pid_children = g_hash_table_lookup(children, GINT_TO_POINTER(pid));
+    if (pid_children != NULL) {
+      g_array_append_vals(tree, pid_children->data, pid_children->len);
+    }
+  }
+
+  return g_steal_pointer(&tree);
+}
+
+GArray *cobalt_proc_list_by_exe(const char *path) {
+  g_autoptr(GArray) pids = g_array_new(FALSE, FALSE, sizeof(pid_t));
+
+  // The entry point may well be a symlink, while the links in /proc are always
+  // fully resolved.
+  g_autofree char *resolved = realpath(path, NULL);
+  if (resolved == NULL) {
+    return g_steal_pointer(&pids);
+  }
+
+  g_autoptr(GDir) dir = g_dir_open(PROC_PATH, 0, NULL);
+  if (dir == NULL) {
+    return g_steal_pointer(&pids);
+  }
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    pid_t pid = 0;
+    if (!parse_pid(name, &pid)) {
+      continue;
+    }
+
+    g_autofree char *exe_link = g_strdup_printf(PROC_PATH "/%d/exe", pid);
+    g_autofree char *exe = g_file_read_link(exe_link, NULL);
+    if (g_strcmp0(exe, resolved) == 0) {
+      g_array_append_val(pids, pid);
+    }
+  }
+
+  return g_steal_pointer(&pids);
+}
+
+char *cobalt_proc_get_chromium_type(pid_t pid) {
+  g_autofree char *cmdline_path = g_strdup_printf(PROC_PATH "/%d/cmdline", pid);
+  g_autofree char *contents = NULL;
+  gsize length = 0;
+  if (!g_file_get_contents(cmdline_path, &contents, &length, NULL) || length == 0) {
+    return NULL;
+  }
+
+  // Arguments are separated by NULs, and the last one is terminated by one.
+  for (const char *arg = contents; arg < contents + length; arg += strlen(arg) + 1) {
+    if (g_str_has_prefix(arg, CHROMIUM_TYPE_SWITCH)) {
+      return g_strdup(arg + strlen(CHROMIUM_TYPE_SWITCH));
+    }
+  }
+
+  return g_strdup(CHROMIUM_TYPE_BROWSER);
+}
+
+GArray *cobalt_proc_list_threads(pid_t pid) {
+  g_autoptr(GArray) threads = g_array_new(FALSE, FALSE, sizeof(pid_t));
+
+  g_autofree char *task_path = g_strdup_printf(PROC_PATH "/%d/task", pid);
+  g_autoptr(GDir) dir = g_dir_open(task_path, 0, NULL);
+  if (dir == NULL) {
+    return g_steal_pointer(&threads);
+  }
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    pid_t tid = 0;
+    if (parse_pid(name, &tid)) {
+      g_array_append_val(threads, tid);
+    }
+  }
+
+  return g_steal_pointer(&threads);
+}
@@ -0,0 +1,26 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+#include <sys/types.h>
+
+gboolean cobalt_proc_is_alive(pid_t pid);
+
+// Returns an array of pid_t, containing the given root process (if it still
+// exists) followed by all of its descendants.
+GArray *cobalt_proc_list_tree(pid_t root);
+
+// Returns an array of pid_t, containing every visible process running the
+// executable at path.
+GArray *cobalt_proc_list_by_exe(const char *path);
+
+// Returns the value of Chromium's --type= switch on the process's command line,
+// e.g. "renderer", or "browser" for the main process, which has none. Returns
+// NULL if the command line couldn't be read.
+char *cobalt_proc_get_chromium_type(pid_t pid);
+
+// Returns an array of pid_t, containing all the threads of the given process.
+GArray *cobalt_proc_list_threads(pid_t pid);
@@ -0,0 +1,627 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-profile-ram.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-profile.h"
+#include "cobalt-sched.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <sqlite3.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Everything lives under XDG_RUNTIME_DIR/app/APP_ID, since that's the only
+// part of the runtime dir that is shared between instances of the same app.
+#define RAM_ROOT_SUBDIR "cobalt-profile"
+#define RAM_PROFILE "profile"
+#define RAM_HELPER_LOCK "helper.lock"
+#define RAM_STATE_LOCK "state.lock"
+#define RAM_LAUNCH_STAMP "launch-stamp"
+
+#define PERSISTENT_NEW_SUFFIX ".cobalt-new"
+#define PERSISTENT_OLD_SUFFIX ".cobalt-old"
+#define PERSISTENT_JOURNAL_SUFFIX ".cobalt-journal"
+#define TEMPORARY_SUFFIX ".tmp"
+
+#define HELPER_POLL_INTERVAL 5
+// How long after the last launch the helper waits for the browser to show up
+// before deciding it has exited.
+#define HELPER_LAUNCH_GRACE_PERIOD (60 * G_TIME_SPAN_SECOND)
+#define HELPER_NICE 10
+
+// In milliseconds, how long a snapshot waits for the browser to finish a write.
+#define SNAPSHOT_BUSY_TIMEOUT 1000
+
+#define SINGLETON_PREFIX "Singleton"
+
+// Skipped in both directions, since they would just waste RAM. If they were
+// moved elsewhere with [Cache], they're symlinks and are kept.
+static const char *SKIPPED_CACHE_NAMES[] = {
+    "Cache",         "Code Cache",        "GPUCache", "ShaderCache",
+    "GrShaderCache", "GraphiteDawnCache", NULL,
+};
+
+// Files SQLite keeps next to a database. They're folded into the snapshot of the
+// database itself.
+static const char *DATABASE_COMPANION_SUFFIXES[] = {"-wal", "-shm", "-journal", NULL};
+
+static volatile sig_atomic_t helper_terminating = 0;
+
+static gboolean is_skipped(const char *name, const char *path) {
+  // The singleton files only make sense for the running instance.
+  if (g_str_has_prefix(name, SINGLETON_PREFIX)) {
+    return TRUE;
+  }
+
+  return g_strv_contains(SKIPPED_CACHE_NAMES, name) &&
+         !g_file_test(path, G_FILE_TEST_IS_SYMLINK);
+}
+
+static gboolean is_unchanged(const struct stat *source_st, const char *reference) {
+  struct stat reference_st;
+  return reference != NULL && lstat(reference, &reference_st) == 0 &&
+         S_ISREG(reference_st.st_mode) && reference_st.st_size == source_st->st_size &&
+         reference_st.st_mtim.tv_sec == source_st->st_mtim.tv_sec &&
+         reference_st.st_mtim.tv_nsec == source_st->st_mtim.tv_nsec;
+}
+
+static GHashTable *list_databases(const char *profile_dir) {
+  GHashTable *databases = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    for (const char *const *database = cobalt_profile_get_databases(); *database != NULL;
+         database++) {
+      g_hash_table_add(databases, g_build_filename(profiles->pdata[i], *database, NULL));
+    }
+  }
+
+  return databases;
+}
+
+static gboolean is_database_companion(GHashTable *databases, const char *path) {
+  if (databases == NULL) {
+    return FALSE;
+  }
+
+  for (const char **suffix = DATABASE_COMPANION_SUFFIXES; *suffix != NULL; suffix++) {
+    if (g_str_has_suffix(path, *suffix)) {
+      g_autofree char *database = g_strndup(path, strlen(path) - strlen(*suffix));
+      if (g_hash_table_contains(databases, database)) {
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
+// An empty journal or WAL is left behind once everything in it made it into the
+// database itself.
+static gboolean has_pending_changes(const char *database) {
+  for (const char **suffix = DATABASE_COMPANION_SUFFIXES; *suffix != NULL; suffix++) {
+    g_autofree char *path = g_strconcat(database, *suffix, NULL);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISREG(st.st_mode) && st.st_size != 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void remove_database(const char *path) {
+  unlink(path);
+  for (const char **suffix = DATABASE_COMPANION_SUFFIXES; *suffix != NULL; suffix++) {
+    g_autofree char *companion = g_strconcat(path, *suffix, NULL);
+    unlink(companion);
+  }
+}
+
+// Copies the database through SQLite's backup API, which reads it within a single
+// transaction, so the copy is consistent even while the browser writes to it.
+static gboolean snapshot_database(const char *source, const struct stat *source_st,
+                                  const char *dest, GError **error) {
+  sqlite3 *source_db = NULL;
+  sqlite3 *dest_db = NULL;
+  int result = sqlite3_open_v2(source, &source_db, SQLITE_OPEN_READWRITE, NULL);
+  if (result == SQLITE_OK) {
+    result = sqlite3_open_v2(dest, &dest_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                             NULL);
+  }
+
+  if (result == SQLITE_OK) {
+    sqlite3_busy_timeout(source_db, SNAPSHOT_BUSY_TIMEOUT);
+
+    sqlite3_backup *backup = sqlite3_backup_init(dest_db, "main", source_db, "main");
+    if (backup != NULL) {
+      // A busy database only shows up in the step, not when finishing.
+      int step_result = sqlite3_backup_step(backup, -1);
+      result = sqlite3_backup_finish(backup);
+      if (step_result != SQLITE_DONE && result == SQLITE_OK) {
+        result = step_result;
+      }
+    } else {
+      result = sqlite3_errcode(dest_db);
+    }
+  }
+
+  sqlite3_close(dest_db);
+  sqlite3_close(source_db);
+
+  if (result != SQLITE_OK) {
+    remove_database(dest);
+
+    int code = result == SQLITE_BUSY || result == SQLITE_LOCKED ? G_IO_ERROR_BUSY
+                                                                : G_IO_ERROR_FAILED;
+    g_set_error(error, G_IO_ERROR, code, "Failed to snapshot '%s': %s", source,
+                sqlite3_errstr(result));
+    return FALSE;
+  }
+
+  // Carry the source's modification time over, so an unchanged database is
+  // hard-linked on the next sync instead of being snapshotted again.
+  struct timespec times[] = {source_st->st_atim, source_st->st_mtim};
+  if (chmod(dest, source_st->st_mode & 07777) == -1 ||
+      utimensat(AT_FDCWD, dest, times, 0) == -1) {
+    return cobalt_util_set_error_from_errno(error, "update", dest);
+  }
+
+  return TRUE;
+}
+
+// The browser keeps some databases locked for as long as it runs, so those keep
+// the version from the last sync that could read them.
+static gboolean carry_over_database(const char *reference, const char *dest,
+                                    GError **error) {
+  if (reference == NULL || !g_file_test(reference, G_FILE_TEST_IS_REGULAR)) {
+    return TRUE;
+  }
+
+  if (link(reference, dest) == -1) {
+    return cobalt_util_set_error_from_errno(error, "link", dest);
+  }
+
+  for (const char **suffix = DATABASE_COMPANION_SUFFIXES; *suffix != NULL; suffix++) {
+    g_autofree char *companion_reference = g_strconcat(reference, *suffix, NULL);
+    g_autofree char *companion_dest = g_strconcat(dest, *suffix, NULL);
+    if (g_file_test(companion_reference, G_FILE_TEST_IS_REGULAR) &&
+        link(companion_reference, companion_dest) == -1) {
+      return cobalt_util_set_error_from_errno(error, "link", companion_dest);
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean build_database(const char *source, const struct stat *source_st,
+                               const char *reference, const char *dest,
+                               GError **error) {
+  if (is_unchanged(source_st, reference) && !has_pending_changes(source)) {
+    if (link(reference, dest) == -1) {
+      return cobalt_util_set_error_from_errno(error, "link", dest);
+    }
+
+    return TRUE;
+  }
+
+  g_autoptr(GError) local_error = NULL;
+  if (snapshot_database(source, source_st, dest, &local_error)) {
+    return TRUE;
+  }
+
+  if (!g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_BUSY)) {
+    g_propagate_error(error, g_steal_pointer(&local_error));
+    return FALSE;
+  }
+
+  g_debug("%s, keeping the previous copy", local_error->message);
+  return carry_over_database(reference, dest, error);
+}
+
+// Recreates source at dest. Any regular file that is unchanged from its
+// counterpart under reference (if given) is hard-linked instead of copied, so
+// syncing back only writes what actually changed. The paths in databases (if
+// given) are snapshotted through SQLite instead, since the browser may be
+// writing to them.
+static gboolean build_tree(const char *source, const char *reference, const char *dest,
+                           GHashTable *databases, GError **error) {
+  struct stat st;
+  if (lstat(source, &st) == -1) {
+    return cobalt_util_set_error_from_errno(error, "stat", source);
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    if (mkdir(dest, st.st_mode & 07777) == -1) {
+      return cobalt_util_set_error_from_errno(error, "create", dest);
+    }
+
+    g_autoptr(GDir) dir = g_dir_open(source, 0, error);
+    if (dir == NULL) {
+      return FALSE;
+    }
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+      g_autofree char *child_source = g_build_filename(source, name, NULL);
+      g_autofree char *child_reference =
+          reference != NULL ? g_build_filename(reference, name, NULL) : NULL;
+      g_autofree char *child_dest = g_build_filename(dest, name, NULL);
+
+      if (is_skipped(name, child_source) ||
+          is_database_companion(databases, child_source)) {
+        continue;
+      }
+
+      if (!build_tree(child_source, child_reference, child_dest, databases, error)) {
+        return FALSE;
+      }
+    }
+  } else if (S_ISLNK(st.st_mode)) {
+    g_autofree char *target = g_file_read_link(source, error);
+    if (target == NULL) {
+      return FALSE;
+    }
+
+    if (symlink(target, dest) == -1) {
+      return cobalt_util_set_error_from_errno(error, "create", dest);
+    }
+  } else if (S_ISREG(st.st_mode)) {
+    if (databases != NULL && g_hash_table_contains(databases, source)) {
+      return build_database(source, &st, reference, dest, error);
+    }
+
+    if (is_unchanged(&st, reference)) {
+      if (link(reference, dest) == -1) {
+        return cobalt_util_set_error_from_errno(error, "link", dest);
+      }
+    } else if (!cobalt_util_copy_file(source, dest, FALSE, error)) {
+      return FALSE;
+    }
+  }
+
+  // Anything else (sockets, FIFOs) is specific to the running instance.
+  return TRUE;
+}
+
+static gboolean fsync_path(const char *path, int flags, GError **error) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC | flags);
+  if (fd == -1) {
+    return cobalt_util_set_error_from_errno(error, "open", path);
+  }
+
+  gboolean success =
+      fsync(fd) == 0 || cobalt_util_set_error_from_errno(error, "sync", path);
+  close(fd);
+  return success;
+}
+
+static gboolean sync_filesystem(const char *path, GError **error) {
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    return cobalt_util_set_error_from_errno(error, "open", path);
+  }
+
+  gboolean success =
+      syncfs(fd) == 0 || cobalt_util_set_error_from_errno(error, "sync", path);
+  close(fd);
+  return success;
+}
+
+static char *get_persistent_path(const char *persistent_dir, const char *suffix) {
+  return g_strconcat(persistent_dir, suffix, NULL);
+}
+
+// Finishes or rolls back a sync that was interrupted by a crash or power loss.
+// The journal is only written once the new copy is complete and on disk, so if
+// it exists, the new copy can be swapped in; otherwise, it's discarded.
+static gboolean recover_persistent(const char *persistent_dir, GError **error) {
+  g_autofree char *new_dir = get_persistent_path(persistent_dir, PERSISTENT_NEW_SUFFIX);
+  g_autofree char *old_dir = get_persistent_path(persistent_dir, PERSISTENT_OLD_SUFFIX);
+  g_autofree char *journal =
+      get_persistent_path(persistent_dir, PERSISTENT_JOURNAL_SUFFIX);
+
+  if (g_file_test(journal, G_FILE_TEST_EXISTS)) {
+    if (g_file_test(new_dir, G_FILE_TEST_IS_DIR)) {
+      g_debug("Completing interrupted profile sync to '%s'", persistent_dir);
+
+      if (g_file_test(persistent_dir, G_FILE_TEST_EXISTS) &&
+          rename(persistent_dir, old_dir) == -1) {
+        return cobalt_util_set_error_from_errno(error, "move aside", persistent_dir);
+      }
+
+      if (rename(new_dir, persistent_dir) == -1) {
+        return cobalt_util_set_error_from_errno(error, "move into place", new_dir);
+      }
+    }
+  } else {
+    if (!cobalt_util_remove_tree(new_dir, error)) {
+      return FALSE;
+    }
+
+    if (!g_file_test(persistent_dir, G_FILE_TEST_EXISTS) &&
+        g_file_test(old_dir, G_FILE_TEST_IS_DIR) && rename(old_dir, persistent_dir) == -1) {
+      return cobalt_util_set_error_from_errno(error, "restore", old_dir);
+    }
+  }
+
+  if (!cobalt_util_remove_tree(old_dir, error)) {
+    return FALSE;
+  }
+
+  if (unlink(journal) == -1 && errno != ENOENT) {
+    return cobalt_util_set_error_from_errno(error, "remove", journal);
+  }
+
+  return TRUE;
+}
+
+static gboolean sync_to_persistent(const char *ram_dir, const char *persistent_dir,
+                                   GError **error) {
+  g_autofree char *new_dir = get_persistent_path(persistent_dir, PERSISTENT_NEW_SUFFIX);
+  g_autofree char *journal =
+      get_persistent_path(persistent_dir, PERSISTENT_JOURNAL_SUFFIX);
+
+  g_debug("Syncing profile '%s' to '%s'", ram_dir, persistent_dir);
+  gint64 start = g_get_monotonic_time();
+
+  if (!cobalt_util_remove_tree(new_dir, error)) {
+    return FALSE;
+  }
+
+  const char *reference =
+      g_file_test(persistent_dir, G_FILE_TEST_IS_DIR) ? persistent_dir : NULL;
+  g_autoptr(GHashTable) databases = list_databases(ram_dir);
+  if (!build_tree(ram_dir, reference, new_dir, databases, error) ||
+      !sync_filesystem(new_dir, error)) {
+    return FALSE;
+  }
+
+  // The journal commits the sync, so it and its directory entry must be on disk
+  // before anything is renamed based on it.
+  int journal_fd = open(journal, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (journal_fd == -1) {
+    return cobalt_util_set_error_from_errno(error, "create", journal);
+  }
+
+  gboolean journal_synced =
+      fsync(journal_fd) == 0 || cobalt_util_set_error_from_errno(error, "sync", journal);
+  close(journal_fd);
+
+  g_autofree char *parent = g_path_get_dirname(persistent_dir);
+  if (!journal_synced || !fsync_path(parent, O_DIRECTORY, error)) {
+    return FALSE;
+  }
+
+  if (!recover_persistent(persistent_dir, error)) {
+    return FALSE;
+  }
+
+  if (!sync_filesystem(parent, error)) {
+    return FALSE;
+  }
+
+  g_debug("Synced profile in %" G_GINT64_FORMAT "ms",
+          (g_get_monotonic_time() - start) / G_TIME_SPAN_MILLISECOND);
+  return TRUE;
+}
+
+static gboolean copy_to_ram(const char *persistent_dir, const char *ram_dir,
+                            GError **error) {
+  g_autofree char *tmp_dir = g_strconcat(ram_dir, TEMPORARY_SUFFIX, NULL);
+  if (!cobalt_util_remove_tree(tmp_dir, error)) {
+    return FALSE;
+  }
+
+  if (g_file_test(persistent_dir, G_FILE_TEST_IS_DIR)) {
+    g_debug("Copying profile '%s' to '%s'", persistent_dir, ram_dir);
+    if (!build_tree(persistent_dir, NULL, tmp_dir, NULL, error)) {
+      return FALSE;
+    }
+  } else if (mkdir(tmp_dir, 0700) == -1) {
+    return cobalt_util_set_error_from_errno(error, "create", tmp_dir);
+  }
+
+  if (rename(tmp_dir, ram_dir) == -1) {
+    return cobalt_util_set_error_from_errno(error, "move into place", tmp_dir);
+  }
+
+  return TRUE;
+}
+
+static gboolean touch_launch_stamp(const char *ram_root, GError **error) {
+  g_autofree char *stamp = g_build_filename(ram_root, RAM_LAUNCH_STAMP, NULL);
+  return g_file_set_contents(stamp, "", 0, error);
+}
+
+static gboolean prepare_ram_copy(const char *ram_root, const char *ram_dir,
+                                 const char *persistent_dir, guint sync_interval,
+                                 int helper_fd, gboolean *created, GError **error) {
+  *created = FALSE;
+
+  if (!recover_persistent(persistent_dir, error)) {
+    return FALSE;
+  }
+
+  if (g_file_test(ram_dir, G_FILE_TEST_IS_DIR)) {
+    // The previous helper died without cleaning up, so this copy may have
+    // changes that never made it back.
+    g_debug("Found a leftover copy of the profile in '%s'", ram_dir);
+    if (!sync_to_persistent(ram_dir, persistent_dir, error)) {
+      return FALSE;
+    }
+  } else if (copy_to_ram(persistent_dir, ram_dir, error)) {
+    *created = TRUE;
+  } else {
+    return FALSE;
+  }
+
+  if (!touch_launch_stamp(ram_root, error)) {
+    return FALSE;
+  }
+
+  g_autofree char *sync_interval_string = g_strdup_printf("%u", sync_interval);
+  return cobalt_helper_spawn_with_fd(COBALT_PROFILE_RAM_HELPER_SYNC, helper_fd, error,
+                                     ram_root, persistent_dir, sync_interval_string,
+                                     NULL);
+}
+
+static char *get_ram_root(const char *app_id) {
+  return g_build_filename(g_get_user_runtime_dir(), "app", app_id, RAM_ROOT_SUBDIR,
+                          NULL);
+}
+
+char *cobalt_profile_ram_get_dir(const char *app_id) {
+  g_autofree char *ram_root = get_ram_root(app_id);
+  return g_build_filename(ram_root, RAM_PROFILE, NULL);
+}
+
+char *cobalt_profile_ram_setup(const char *app_id, const char *persistent_dir,
+                               guint sync_interval, GError **error) {
+  g_autofree char *ram_root = get_ram_root(app_id);
+  g_autofree char *ram_dir = g_build_filename(ram_root, RAM_PROFILE, NULL);
+  g_autofree char *state_lock = g_build_filename(ram_root, RAM_STATE_LOCK, NULL);
+  g_autofree char *helper_lock = g_build_filename(ram_root, RAM_HELPER_LOCK, NULL);
+
+  if (g_mkdir_with_parents(ram_root, 0700) == -1) {
+    cobalt_util_set_error_from_errno(error, "create", ram_root);
+    return NULL;
+  }
+
+  // Held while deciding whether to reuse the copy, so the helper can't decide
+  // the browser is gone and remove it in the meantime.
+  int state_fd = cobalt_util_open_lock(state_lock, LOCK_EX, error);
+  if (state_fd == -1) {
+    return NULL;
+  }
+
+  g_autoptr(GError) local_error = NULL;
+  int helper_fd = cobalt_util_open_lock(helper_lock, LOCK_EX | LOCK_NB, &local_error);
+  if (helper_fd == -1) {
+    if (!g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_propagate_error(error, g_steal_pointer(&local_error));
+      close(state_fd);
+      return NULL;
+    }
+
+    g_debug("Profile is already in RAM at '%s'", ram_dir);
+    gboolean success = touch_launch_stamp(ram_root, error);
+    close(state_fd);
+    return success ? g_steal_pointer(&ram_dir) : NULL;
+  }
+
+  gboolean created = FALSE;
+  gboolean success = prepare_ram_copy(ram_root, ram_dir, persistent_dir, sync_interval,
+                                      helper_fd, &created, error);
+  if (!success && created) {
+    // Without a helper, nothing would ever be synced back, so don't leave a
+    // copy around that a later launch might mistake for newer data.
+    g_autoptr(GError) remove_error = NULL;
+    if (!cobalt_util_remove_tree(ram_dir, &remove_error)) {
+      g_warning("Failed to remove '%s': %s", ram_dir, remove_error->message);
+    }
+  }
+
+  // The helper now holds its own reference to the lock.
+  close(helper_fd);
+  close(state_fd);
+  return success ? g_steal_pointer(&ram_dir) : NULL;
+}
+
+static void helper_handle_signal(int signum) { helper_terminating = 1; }
+
+static gboolean helper_try_finish(const char *ram_root, const char *ram_dir,
+                                  const char *persistent_dir) {
+  g_autoptr(GError) error = NULL;
+
+  g_autofree char *state_lock = g_build_filename(ram_root, RAM_STATE_LOCK, NULL);
+  int state_fd = cobalt_util_open_lock(state_lock, LOCK_EX, &error);
+  if (state_fd == -1) {
+    g_warning("%s", error->message);
+    return FALSE;
+  }
+
+  g_autofree char *stamp = g_build_filename(ram_root, RAM_LAUNCH_STAMP, NULL);
+  struct stat st;
+  gint64 last_launch = stat(stamp, &st) == 0
+                           ? st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000
+                           : 0;
+
+  gboolean browser_exited = g_get_real_time() - last_launch > HELPER_LAUNCH_GRACE_PERIOD &&
+                            !cobalt_profile_is_running(ram_dir);
+  if (!browser_exited && !helper_terminating) {
+    close(state_fd);
+    return FALSE;
+  }
+
+  // If the session is ending under a browser that is still running, the copy is
+  // kept, so whatever it writes after this snapshot is picked up by the next
+  // launch, if the runtime dir survives until then. If anything fails, the copy
+  // is left alone too, so the next launch can retry.
+  if (!sync_to_persistent(ram_dir, persistent_dir, &error)) {
+    g_warning("Failed to sync profile back on exit: %s", error->message);
+  } else if (browser_exited && !cobalt_util_remove_tree(ram_dir, &error)) {
+    g_warning("Failed to remove '%s': %s", ram_dir, error->message);
+  }
+
+  // Release the helper lock before the state lock, so the next launch never
+  // sees a helper that is about to go away.
+  close(COBALT_HELPER_INHERITED_FD);
+  close(state_fd);
+  return TRUE;
+}
+
+int cobalt_profile_ram_helper_sync(int argc, char **argv) {
+  if (argc != 3) {
+    g_printerr("usage: " COBALT_PROFILE_RAM_HELPER_SYNC " RAM-ROOT PERSISTENT-DIR "
+               "INTERVAL\n");
+    return 1;
+  }
+
+  const char *ram_root = argv[0];
+  const char *persistent_dir = argv[1];
+  gint64 interval = g_ascii_strtoull(argv[2], NULL, 10) * 60 * G_TIME_SPAN_SECOND;
+
+  g_autofree char *ram_dir = g_build_filename(ram_root, RAM_PROFILE, NULL);
+
+  // Sync back one last time when the session is being torn down, since the
+  // runtime dir will be gone afterwards.
+  struct sigaction action = {.sa_handler = helper_handle_signal};
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+
+  setpriority(PRIO_PROCESS, 0, HELPER_NICE);
+  cobalt_sched_set_io_priority(0, COBALT_SCHED_IO_CLASS_IDLE, 0, NULL);
+
+  gint64 last_sync = g_get_monotonic_time();
+  for (;;) {
+    // Not g_usleep, which would restart after being interrupted by a signal.
+    sleep(HELPER_POLL_INTERVAL);
+
+    if (helper_try_finish(ram_root, ram_dir, persistent_dir)) {
+      break;
+    }
+
+    if (interval != 0 && g_get_monotonic_time() - last_sync >= interval) {
+      g_autoptr(GError) error = NULL;
+      if (!sync_to_persistent(ram_dir, persistent_dir, &error)) {
+        g_warning("Failed to sync profile: %s", error->message);
+      }
+
+      last_sync = g_get_monotonic_time();
+    }
+  }
+
+  return 0;
+}
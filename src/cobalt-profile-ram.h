@@ -0,0 +1,22 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+#define COBALT_PROFILE_RAM_HELPER_SYNC "profile-sync"
+
+// Sets up a copy of the profile at persistent_dir in XDG_RUNTIME_DIR, along
+// with a helper that syncs it back every sync_interval minutes and once the
+// browser exits. Returns the path of the copy, which may already have been
+// set up by a previous launch that is still running.
+char *cobalt_profile_ram_setup(const char *app_id, const char *persistent_dir,
+                               guint sync_interval, GError **error);
+
+// Returns where the copy of the profile is kept for the given app, whether or not
+// it's currently set up.
+char *cobalt_profile_ram_get_dir(const char *app_id);
+
+int cobalt_profile_ram_helper_sync(int argc, char **argv);
@@ -0,0 +1,99 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-profile.h"
+
+#include "cobalt-proc.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DEFAULT_PROFILE "Default"
+#define PROFILE_PREFIX "Profile "
+
+#define SINGLETON_LOCK "SingletonLock"
+#define SINGLETON_SOCKET "SingletonSocket"
+
+// Relative to each profile directory inside the user data directory.
+static const char *const DATABASES[] = {
+    "History",      "Favicons",        "Web Data",
+    "Top Sites",    "Shortcuts",       "Network Action Predictor",
+    "Login Data",   "Cookies",         "Network/Cookies",
+    NULL,
+};
+
+static gboolean is_socket_listening(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return FALSE;
+  }
+
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return FALSE;
+  }
+
+  gboolean listening = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+  close(fd);
+  return listening;
+}
+
+gboolean cobalt_profile_is_listening(const char *profile_dir) {
+  g_autofree char *socket_link = g_build_filename(profile_dir, SINGLETON_SOCKET, NULL);
+  g_autofree char *socket_path = g_file_read_link(socket_link, NULL);
+  return socket_path != NULL && is_socket_listening(socket_path);
+}
+
+gboolean cobalt_profile_is_running(const char *profile_dir) {
+  // The socket is the only reliable check across Flatpak instances, since each
+  // instance has its own PID namespace.
+  if (cobalt_profile_is_listening(profile_dir)) {
+    return TRUE;
+  }
+
+  // The lock's target is HOSTNAME-PID.
+  g_autofree char *lock_link = g_build_filename(profile_dir, SINGLETON_LOCK, NULL);
+  g_autofree char *lock_target = g_file_read_link(lock_link, NULL);
+  if (lock_target != NULL) {
+    const char *dash = strrchr(lock_target, '-');
+    guint64 pid = 0;
+    if (dash != NULL &&
+        g_ascii_string_to_unsigned(dash + 1, 10, 1, G_MAXINT, &pid, NULL) &&
+        pid != (guint64)getpid() && cobalt_proc_is_alive(pid)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+GPtrArray *cobalt_profile_list(const char *profile_dir) {
+  GPtrArray *profiles = g_ptr_array_new_with_free_func(g_free);
+
+  // The default profile is the one most likely to be used, so it goes first.
+  g_autofree char *default_profile = g_build_filename(profile_dir, DEFAULT_PROFILE, NULL);
+  if (g_file_test(default_profile, G_FILE_TEST_IS_DIR)) {
+    g_ptr_array_add(profiles, g_steal_pointer(&default_profile));
+  }
+
+  g_autoptr(GDir) dir = g_dir_open(profile_dir, 0, NULL);
+  const char *name = NULL;
+  while (dir != NULL && (name = g_dir_read_name(dir)) != NULL) {
+    if (!g_str_has_prefix(name, PROFILE_PREFIX)) {
+      continue;
+    }
+
+    g_autofree char *profile = g_build_filename(profile_dir, name, NULL);
+    if (g_file_test(profile, G_FILE_TEST_IS_DIR)) {
+      g_ptr_array_add(profiles, g_steal_pointer(&profile));
+    }
+  }
+
+  return profiles;
+}
+
+const char *const *cobalt_profile_get_databases(void) { return DATABASES; }
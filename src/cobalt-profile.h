@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+// Checks whether a browser instance currently owns the given user data
+// directory, the same way Chromium's process singleton does.
+gboolean cobalt_profile_is_running(const char *profile_dir);
+
+// Lists the paths of the browser profiles (Default, "Profile 1", ...) inside the
+// given user data directory, with Default first.
+GPtrArray *cobalt_profile_list(const char *profile_dir);
+
+// Returns the NULL-terminated list of the larger SQLite databases in each
+// profile, relative to the profile's directory.
+const char *const *cobalt_profile_get_databases(void);
+
+// Checks only whether the singleton socket in the given user data directory
+// accepts connections. Unlike the lock, the socket can't be left behind by a
+// crashed instance in a way that looks alive.
+gboolean cobalt_profile_is_listening(const char *profile_dir);
@@ -0,0 +1,216 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-sched.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-proc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define OOM_SCORE_ADJ_PATH "/proc/self/oom_score_adj"
+
+// The highest best-effort level, which unprivileged processes may use.
+#define STARTUP_BOOST_IO_LEVEL 0
+
+static int io_class_to_ioprio_class(CobaltSchedIOClass io_class) {
+  switch (io_class) {
+  case COBALT_SCHED_IO_CLASS_UNCHANGED:
+    return IOPRIO_CLASS_NONE;
+  case COBALT_SCHED_IO_CLASS_REALTIME:
+    return IOPRIO_CLASS_RT;
+  case COBALT_SCHED_IO_CLASS_BEST_EFFORT:
+    return IOPRIO_CLASS_BE;
+  case COBALT_SCHED_IO_CLASS_IDLE:
+    return IOPRIO_CLASS_IDLE;
+  }
+
+  g_warn_if_reached();
+  return IOPRIO_CLASS_NONE;
+}
+
+gboolean cobalt_sched_set_io_priority(pid_t pid, CobaltSchedIOClass io_class,
+                                      int io_level, GError **error) {
+  int ioprio_class = io_class_to_ioprio_class(io_class);
+  // Only the best-effort and realtime classes have levels.
+  int ioprio_data = ioprio_class == IOPRIO_CLASS_BE || ioprio_class == IOPRIO_CLASS_RT
+                        ? io_level
+                        : 0;
+
+  if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid,
+              IOPRIO_PRIO_VALUE(ioprio_class, ioprio_data)) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to set I/O priority of %d: %s", pid, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+// Files in /proc can't be replaced, so this writes to it in place rather than
+// going through g_file_set_contents.
+static gboolean set_oom_score_adj(int oom_score_adj, GError **error) {
+  g_autofree char *contents = g_strdup_printf("%d", oom_score_adj);
+
+  int fd = open(OOM_SCORE_ADJ_PATH, O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to open " OOM_SCORE_ADJ_PATH ": %s", g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  gssize written = write(fd, contents, strlen(contents));
+  if (written != (gssize)strlen(contents)) {
+    int saved_errno = written == -1 ? errno : EIO;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to write " OOM_SCORE_ADJ_PATH ": %s", g_strerror(saved_errno));
+    close(fd);
+    return FALSE;
+  }
+
+  close(fd);
+  return TRUE;
+}
+
+static gboolean set_cpu_policy(CobaltSchedCpuPolicy cpu_policy, GError **error) {
+  int policy = SCHED_OTHER;
+  switch (cpu_policy) {
+  case COBALT_SCHED_CPU_POLICY_UNCHANGED:
+    return TRUE;
+  case COBALT_SCHED_CPU_POLICY_OTHER:
+    policy = SCHED_OTHER;
+    break;
+  case COBALT_SCHED_CPU_POLICY_BATCH:
+    policy = SCHED_BATCH;
+    break;
+  case COBALT_SCHED_CPU_POLICY_IDLE:
+    policy = SCHED_IDLE;
+    break;
+  }
+
+  struct sched_param param = {.sched_priority = 0};
+  if (sched_setscheduler(0, policy, &param) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to set scheduling policy: %s", g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void spawn_restore_io_priority(const CobaltSchedPolicy *policy) {
+  g_autoptr(GError) error = NULL;
+
+  g_autofree char *pid = g_strdup_printf("%d", getpid());
+  g_autofree char *io_class = g_strdup_printf("%d", policy->io_class);
+  g_autofree char *io_level = g_strdup_printf("%d", policy->io_level);
+  g_autofree char *delay = g_strdup_printf("%u", policy->startup_io_boost);
+
+  if (!cobalt_helper_spawn(COBALT_SCHED_HELPER_RESTORE_IO_PRIORITY, &error, pid,
+                           io_class, io_level, delay, NULL)) {
+    g_warning("%s", error->message);
+  }
+}
+
+void cobalt_sched_apply(const CobaltSchedPolicy *policy) {
+  g_autoptr(GError) error = NULL;
+
+  if (policy->cpu_policy != COBALT_SCHED_CPU_POLICY_UNCHANGED) {
+    g_debug("Setting scheduling policy to %d", policy->cpu_policy);
+    if (!set_cpu_policy(policy->cpu_policy, &error)) {
+      g_warning("%s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  if (policy->nice_set) {
+    g_debug("Setting nice level to %d", policy->nice);
+    if (setpriority(PRIO_PROCESS, 0, policy->nice) == -1) {
+      g_warning("Failed to set nice level: %s", g_strerror(errno));
+    }
+  }
+
+  if (policy->startup_io_boost != 0) {
+    CobaltSchedIOClass startup_io_class = COBALT_SCHED_IO_CLASS_BEST_EFFORT;
+    int startup_io_level = STARTUP_BOOST_IO_LEVEL;
+    if (policy->startup_io_class != COBALT_SCHED_IO_CLASS_UNCHANGED) {
+      startup_io_class = policy->startup_io_class;
+      startup_io_level = policy->startup_io_level;
+    }
+
+    g_debug("Setting startup I/O priority to class %d, level %d for %us",
+            startup_io_class, startup_io_level, policy->startup_io_boost);
+    if (cobalt_sched_set_io_priority(0, startup_io_class, startup_io_level, &error)) {
+      spawn_restore_io_priority(policy);
+    } else {
+      g_warning("%s", error->message);
+      g_clear_error(&error);
+    }
+  } else if (policy->io_class != COBALT_SCHED_IO_CLASS_UNCHANGED) {
+    g_debug("Setting I/O priority to class %d, level %d", policy->io_class,
+            policy->io_level);
+    if (!cobalt_sched_set_io_priority(0, policy->io_class, policy->io_level, &error)) {
+      g_warning("%s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  if (policy->oom_score_adj_set) {
+    g_debug("Setting OOM score adjustment to %d", policy->oom_score_adj);
+    if (!set_oom_score_adj(policy->oom_score_adj, &error)) {
+      g_warning("Failed to set OOM score adjustment: %s", error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  if (policy->timer_slack != 0) {
+    g_debug("Setting timer slack to %" G_GUINT64_FORMAT "ns", policy->timer_slack);
+    if (prctl(PR_SET_TIMERSLACK, (unsigned long)policy->timer_slack, 0, 0, 0) == -1) {
+      g_warning("Failed to set timer slack: %s", g_strerror(errno));
+    }
+  }
+}
+
+int cobalt_sched_helper_restore_io_priority(int argc, char **argv) {
+  if (argc != 4) {
+    g_printerr("usage: " COBALT_SCHED_HELPER_RESTORE_IO_PRIORITY
+               " PID IO-CLASS IO-LEVEL DELAY\n");
+    return 1;
+  }
+
+  pid_t root = g_ascii_strtoll(argv[0], NULL, 10);
+  CobaltSchedIOClass io_class = g_ascii_strtoll(argv[1], NULL, 10);
+  int io_level = g_ascii_strtoll(argv[2], NULL, 10);
+  guint delay = g_ascii_strtoull(argv[3], NULL, 10);
+
+  g_usleep(delay * G_USEC_PER_SEC);
+
+  // I/O priorities are per-thread, and anything forked during the boost
+  // inherited it, so every thread in the tree needs to be dropped again.
+  g_autoptr(GArray) tree = cobalt_proc_list_tree(root);
+  for (guint i = 0; i < tree->len; i++) {
+    g_autoptr(GArray) threads = cobalt_proc_list_threads(g_array_index(tree, pid_t, i));
+    for (guint j = 0; j < threads->len; j++) {
+      g_autoptr(GError) error = NULL;
+      if (!cobalt_sched_set_io_priority(g_array_index(threads, pid_t, j), io_class,
+                                        io_level, &error)) {
+        g_debug("%s", error->message);
+      }
+    }
+  }
+
+  return 0;
+}
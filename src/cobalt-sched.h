@@ -0,0 +1,61 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+#define COBALT_SCHED_HELPER_RESTORE_IO_PRIORITY "restore-io-priority"
+
+typedef enum CobaltSchedCpuPolicy CobaltSchedCpuPolicy;
+typedef enum CobaltSchedIOClass CobaltSchedIOClass;
+typedef struct CobaltSchedPolicy CobaltSchedPolicy;
+
+enum CobaltSchedCpuPolicy {
+  COBALT_SCHED_CPU_POLICY_UNCHANGED,
+  COBALT_SCHED_CPU_POLICY_OTHER,
+  COBALT_SCHED_CPU_POLICY_BATCH,
+  COBALT_SCHED_CPU_POLICY_IDLE,
+};
+
+enum CobaltSchedIOClass {
+  // Lets the kernel derive the I/O priority from the nice level.
+  COBALT_SCHED_IO_CLASS_UNCHANGED,
+  COBALT_SCHED_IO_CLASS_REALTIME,
+  COBALT_SCHED_IO_CLASS_BEST_EFFORT,
+  COBALT_SCHED_IO_CLASS_IDLE,
+};
+
+struct CobaltSchedPolicy {
+  gboolean nice_set;
+  int nice;
+
+  CobaltSchedIOClass io_class;
+  int io_level;
+
+  gboolean oom_score_adj_set;
+  int oom_score_adj;
+
+  // In nanoseconds, or 0 to leave unchanged.
+  guint64 timer_slack;
+
+  CobaltSchedCpuPolicy cpu_policy;
+
+  // If non-zero, the I/O priority is set to startup_io_class / startup_io_level
+  // for this many seconds after startup, and then dropped to io_class /
+  // io_level by a helper.
+  guint startup_io_boost;
+  // COBALT_SCHED_IO_CLASS_UNCHANGED means the highest best-effort level.
+  CobaltSchedIOClass startup_io_class;
+  int startup_io_level;
+};
+
+gboolean cobalt_sched_set_io_priority(pid_t pid, CobaltSchedIOClass io_class,
+                                      int io_level, GError **error);
+
+// Applies the policy to the calling process, so it will be inherited by
+// everything it execs or forks. Failures are logged but are not fatal.
+void cobalt_sched_apply(const CobaltSchedPolicy *policy);
+
+int cobalt_sched_helper_restore_io_priority(int argc, char **argv);
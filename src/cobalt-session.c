@@ -0,0 +1,247 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-session.h"
+
+#include "cobalt-profile.h"
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SESSIONS_SUBDIR "Sessions"
+#define SESSION_FILE_PREFIX "Session_"
+// Used instead of Sessions/ by older versions.
+#define LEGACY_SESSION_FILE "Current Session"
+
+#define DEFERRED_SESSIONS_PREFIX "Sessions.cobalt-deferred-"
+
+// Session files are a magic number and version, followed by a sequence of
+// commands, each of them a 16-bit little-endian size, a command ID, and the
+// payload. Version 2 is encrypted, so it can't be read here.
+#define SNSS_MAGIC "SNSS"
+#define SNSS_HEADER_SIZE 8
+#define SNSS_VERSION 1
+#define SNSS_VERSION_WITH_MARKER 3
+
+// The commands needed to track which tabs are in which windows. The payloads of
+// all of these start with plain 32-bit IDs.
+#define SNSS_COMMAND_SET_TAB_WINDOW 0
+#define SNSS_COMMAND_TAB_CLOSED 16
+#define SNSS_COMMAND_WINDOW_CLOSED 17
+
+// Everything the browser restores the previous session from, relative to each
+// profile directory. All but the first are used by older versions.
+static const char *SESSION_FILES[] = {
+    SESSIONS_SUBDIR, LEGACY_SESSION_FILE, "Current Tabs", "Last Session", "Last Tabs",
+    NULL,
+};
+
+static guint32 read_le32(const guchar *data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | (guint32)data[3] << 24;
+}
+
+static void replay_session_file(const char *path, CobaltSessionStats *stats) {
+  g_autofree char *contents = NULL;
+  gsize length = 0;
+  g_autoptr(GError) error = NULL;
+  if (!g_file_get_contents(path, &contents, &length, &error)) {
+    g_debug("Failed to read session file: %s", error->message);
+    return;
+  }
+
+  const guchar *data = (const guchar *)contents;
+  if (length < SNSS_HEADER_SIZE || memcmp(data, SNSS_MAGIC, strlen(SNSS_MAGIC)) != 0) {
+    g_debug("'%s' is not a session file", path);
+    return;
+  }
+
+  guint32 version = read_le32(data + strlen(SNSS_MAGIC));
+  if (version != SNSS_VERSION && version != SNSS_VERSION_WITH_MARKER) {
+    g_debug("Session file '%s' has unsupported version %u", path, version);
+    return;
+  }
+
+  // Maps tab IDs to the IDs of the windows they're in.
+  g_autoptr(GHashTable) tabs = g_hash_table_new(NULL, NULL);
+  g_autoptr(GHashTable) windows = g_hash_table_new(NULL, NULL);
+
+  gsize offset = SNSS_HEADER_SIZE;
+  while (offset + 2 <= length) {
+    gsize size = data[offset] | data[offset + 1] << 8;
+    offset += 2;
+    // A truncated command is left behind if the browser died mid-write.
+    if (size == 0 || offset + size > length) {
+      break;
+    }
+
+    guint8 id = data[offset];
+    const guchar *payload = data + offset + 1;
+    gsize payload_size = size - 1;
+    offset += size;
+
+    switch (id) {
+    case SNSS_COMMAND_SET_TAB_WINDOW:
+      if (payload_size >= 8) {
+        guint32 window_id = read_le32(payload);
+        guint32 tab_id = read_le32(payload + 4);
+        g_hash_table_insert(tabs, GUINT_TO_POINTER(tab_id), GUINT_TO_POINTER(window_id));
+        g_hash_table_add(windows, GUINT_TO_POINTER(window_id));
+      }
+      break;
+    case SNSS_COMMAND_TAB_CLOSED:
+      if (payload_size >= 4) {
+        g_hash_table_remove(tabs, GUINT_TO_POINTER(read_le32(payload)));
+      }
+      break;
+    case SNSS_COMMAND_WINDOW_CLOSED:
+      if (payload_size >= 4) {
+        g_hash_table_remove(windows, GUINT_TO_POINTER(read_le32(payload)));
+      }
+      break;
+    }
+  }
+
+  GHashTableIter iter;
+  gpointer window_id = NULL;
+  g_hash_table_iter_init(&iter, tabs);
+  while (g_hash_table_iter_next(&iter, NULL, &window_id)) {
+    if (g_hash_table_contains(windows, window_id)) {
+      stats->tabs++;
+    }
+  }
+
+  stats->windows += g_hash_table_size(windows);
+}
+
+// Session files are named after the time they were created, so the newest one
+// has the largest suffix.
+static char *find_session_file(const char *profile) {
+  g_autofree char *sessions_dir = g_build_filename(profile, SESSIONS_SUBDIR, NULL);
+  g_autoptr(GDir) dir = g_dir_open(sessions_dir, 0, NULL);
+  if (dir == NULL) {
+    g_autofree char *legacy = g_build_filename(profile, LEGACY_SESSION_FILE, NULL);
+    return g_file_test(legacy, G_FILE_TEST_IS_REGULAR) ? g_steal_pointer(&legacy) : NULL;
+  }
+
+  const char *newest = NULL;
+  guint64 newest_timestamp = 0;
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    guint64 timestamp = 0;
+    if (g_str_has_prefix(name, SESSION_FILE_PREFIX) &&
+        g_ascii_string_to_unsigned(name + strlen(SESSION_FILE_PREFIX), 10, 0, G_MAXUINT64,
+                                   &timestamp, NULL) &&
+        (newest == NULL || timestamp > newest_timestamp)) {
+      newest = name;
+      newest_timestamp = timestamp;
+    }
+  }
+
+  return newest != NULL ? g_build_filename(sessions_dir, newest, NULL) : NULL;
+}
+
+void cobalt_session_estimate(const char *profile_dir, CobaltSessionStats *stats) {
+  *stats = (CobaltSessionStats){0};
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    g_autofree char *session_file = find_session_file(profiles->pdata[i]);
+    if (session_file != NULL) {
+      replay_session_file(session_file, stats);
+    }
+  }
+}
+
+// Only the most recently deferred session is kept, so they don't pile up in the
+// profile.
+static void prune_deferred_sessions(const char *profile, const char *keep_name) {
+  g_autoptr(GDir) dir = g_dir_open(profile, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+
+  const char *name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    if (!g_str_has_prefix(name, DEFERRED_SESSIONS_PREFIX) ||
+        g_str_equal(name, keep_name)) {
+      continue;
+    }
+
+    g_autofree char *path = g_build_filename(profile, name, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!cobalt_util_remove_tree(path, &error)) {
+      g_warning("Failed to remove old deferred session: %s", error->message);
+    }
+  }
+}
+
+static gboolean defer_profile_sessions(const char *profile, gint64 timestamp,
+                                       GError **error) {
+  g_autofree char *deferred_name =
+      g_strdup_printf(DEFERRED_SESSIONS_PREFIX "%" G_GINT64_FORMAT, timestamp);
+  g_autofree char *deferred_dir = g_build_filename(profile, deferred_name, NULL);
+
+  gboolean created = FALSE;
+  for (const char **file = SESSION_FILES; *file != NULL; file++) {
+    g_autofree char *source = g_build_filename(profile, *file, NULL);
+    if (!g_file_test(source, G_FILE_TEST_EXISTS)) {
+      continue;
+    }
+
+    if (!created) {
+      if (mkdir(deferred_dir, 0700) == -1) {
+        int saved_errno = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Failed to create '%s': %s", deferred_dir, g_strerror(saved_errno));
+        return FALSE;
+      }
+
+      created = TRUE;
+    }
+
+    g_autofree char *dest = g_build_filename(deferred_dir, *file, NULL);
+    if (rename(source, dest) == -1) {
+      int saved_errno = errno;
+      g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                  "Failed to move '%s' aside: %s", source, g_strerror(saved_errno));
+      return FALSE;
+    }
+  }
+
+  if (created) {
+    g_warning("Saved session was too large to restore, moved it to '%s'", deferred_dir);
+    prune_deferred_sessions(profile, deferred_name);
+  }
+
+  return TRUE;
+}
+
+gboolean cobalt_session_defer(const char *profile_dir, GError **error) {
+  gint64 timestamp = g_get_real_time() / G_USEC_PER_SEC;
+
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    if (!defer_profile_sessions(profiles->pdata[i], timestamp, error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+void cobalt_session_remove(const char *profile_dir) {
+  g_autoptr(GPtrArray) profiles = cobalt_profile_list(profile_dir);
+  for (guint i = 0; i < profiles->len; i++) {
+    for (const char **file = SESSION_FILES; *file != NULL; file++) {
+      g_autofree char *path = g_build_filename(profiles->pdata[i], *file, NULL);
+      g_autoptr(GError) error = NULL;
+      if (!cobalt_util_remove_tree(path, &error)) {
+        g_warning("Failed to clean up session state: %s", error->message);
+      }
+    }
+  }
+}
@@ -0,0 +1,29 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+typedef struct CobaltSessionStats CobaltSessionStats;
+
+struct CobaltSessionStats {
+  guint windows;
+  guint tabs;
+};
+
+// Estimates how much the browser will restore on startup by replaying the
+// window and tab bookkeeping in the newest session file of every profile under
+// profile_dir. Profiles without a readable session count as empty.
+void cobalt_session_estimate(const char *profile_dir, CobaltSessionStats *stats);
+
+// Moves the saved sessions of every profile under profile_dir aside, so the
+// browser starts with a single new window instead. They're kept next to the
+// original location, in Sessions.cobalt-deferred-TIMESTAMP, replacing any that
+// were deferred before.
+gboolean cobalt_session_defer(const char *profile_dir, GError **error);
+
+// Removes the saved sessions of every profile under profile_dir, logging any
+// failures.
+void cobalt_session_remove(const char *profile_dir);
@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-shm.h"
+
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+
+#define DEV_SHM_PATH "/dev/shm"
+
+#define FALLBACK_SUBDIR "cobalt-tmp"
+
+#define DISABLE_DEV_SHM_USAGE_FLAG "--disable-dev-shm-usage"
+
+static guint64 compute_expected_size(CobaltConfig *config) {
+  guint64 expected = config->shared_memory.min_size_mb * 1024 * 1024;
+
+  if (config->shared_memory.min_size_percent != 0) {
+    g_autoptr(GError) error = NULL;
+    guint64 total_memory = 0;
+    if (cobalt_util_read_meminfo("MemTotal", &total_memory, &error)) {
+      expected =
+          MAX(expected, total_memory / 100 * config->shared_memory.min_size_percent);
+    } else {
+      g_warning("Failed to get total memory: %s", error->message);
+    }
+  }
+
+  return expected;
+}
+
+// The app's own directory under XDG_RUNTIME_DIR is a tmpfs that's private to the
+// app, so it's just as fast as /dev/shm, but isn't limited by the sandbox.
+static char *get_fallback_dir(CobaltHost *host, GError **error) {
+  const char *app_id = cobalt_host_get_app_id(host, error);
+  if (app_id == NULL) {
+    g_prefix_error(error, "Failed to get app ID: ");
+    return NULL;
+  }
+
+  g_autofree char *dir =
+      g_build_filename(g_get_user_runtime_dir(), "app", app_id, FALLBACK_SUBDIR, NULL);
+  if (g_mkdir_with_parents(dir, 0700) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", dir, g_strerror(saved_errno));
+    return NULL;
+  }
+
+  return g_steal_pointer(&dir);
+}
+
+gboolean cobalt_shm_check(CobaltConfig *config, CobaltHost *host,
+                          CobaltLauncher *launcher, GError **error) {
+  guint64 expected = compute_expected_size(config);
+
+  guint64 available = 0;
+  g_autoptr(GError) local_error = NULL;
+  if (!cobalt_util_get_free_space(DEV_SHM_PATH, &available, &local_error)) {
+    // Without /dev/shm at all, the browser falls back by itself.
+    g_debug("Failed to probe " DEV_SHM_PATH ": %s", local_error->message);
+    return TRUE;
+  }
+
+  g_debug("%s has %" G_GUINT64_FORMAT " bytes free, expecting %" G_GUINT64_FORMAT,
+          DEV_SHM_PATH, available, expected);
+  if (available >= expected) {
+    return TRUE;
+  }
+
+  g_autofree char *fallback_dir = get_fallback_dir(host, error);
+  if (fallback_dir == NULL) {
+    return FALSE;
+  }
+
+  guint64 fallback_available = 0;
+  if (!cobalt_util_get_free_space(fallback_dir, &fallback_available, error)) {
+    return FALSE;
+  }
+
+  // If the fallback is even tighter, the browser is better off with /dev/shm.
+  if (fallback_available <= available) {
+    g_debug("'%s' only has %" G_GUINT64_FORMAT " bytes free, keeping " DEV_SHM_PATH,
+            fallback_dir, fallback_available);
+    return TRUE;
+  }
+
+  g_debug(DEV_SHM_PATH " is too small, using '%s' for shared memory instead",
+          fallback_dir);
+  cobalt_launcher_add_arg(launcher, DISABLE_DEV_SHM_USAGE_FLAG);
+  cobalt_launcher_setenv(launcher, "TMPDIR", fallback_dir);
+  return TRUE;
+}
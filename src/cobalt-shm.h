@@ -0,0 +1,17 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+#include "cobalt-host.h"
+#include "cobalt-launcher.h"
+
+#include <glib.h>
+
+// Checks whether /dev/shm has room for the browser's shared memory, as
+// configured by [SharedMemory], and if not, has the browser put it into a
+// tmpfs-backed TMPDIR instead.
+gboolean cobalt_shm_check(CobaltConfig *config, CobaltHost *host,
+                          CobaltLauncher *launcher, GError **error);
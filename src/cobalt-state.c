@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-state.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+
+struct CobaltState {
+  char *path;
+  GKeyFile *key_file;
+  gboolean dirty;
+};
+
+CobaltState *cobalt_state_load(const char *name) {
+  CobaltState *state = g_new0(CobaltState, 1);
+
+  g_autofree char *filename = g_strdup_printf("cobalt-%s-state.ini", name);
+  state->path = g_build_filename(g_get_user_data_dir(), filename, NULL);
+  state->key_file = g_key_file_new();
+
+  g_autoptr(GError) local_error = NULL;
+  if (!g_key_file_load_from_file(state->key_file, state->path, G_KEY_FILE_NONE,
+                                 &local_error)) {
+    if (!g_error_matches(local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_warning("Failed to load state file '%s', starting over: %s", state->path,
+                local_error->message);
+    }
+
+    g_key_file_unref(state->key_file);
+    state->key_file = g_key_file_new();
+  }
+
+  return state;
+}
+
+char *cobalt_state_get_string(CobaltState *state, const char *group, const char *key) {
+  return g_key_file_get_string(state->key_file, group, key, NULL);
+}
+
+void cobalt_state_set_string(CobaltState *state, const char *group, const char *key,
+                             const char *value) {
+  g_autofree char *current = cobalt_state_get_string(state, group, key);
+  if (g_strcmp0(current, value) == 0) {
+    return;
+  }
+
+  if (value != NULL) {
+    g_key_file_set_string(state->key_file, group, key, value);
+  } else {
+    g_key_file_remove_key(state->key_file, group, key, NULL);
+  }
+
+  state->dirty = TRUE;
+}
+
+gint64 cobalt_state_get_int64(CobaltState *state, const char *group, const char *key,
+                              gint64 default_value) {
+  g_autofree char *string = cobalt_state_get_string(state, group, key);
+  gint64 value = 0;
+  if (string == NULL || !g_ascii_string_to_signed(string, 10, G_MININT64, G_MAXINT64,
+                                                  &value, NULL)) {
+    return default_value;
+  }
+
+  return value;
+}
+
+void cobalt_state_set_int64(CobaltState *state, const char *group, const char *key,
+                            gint64 value) {
+  g_autofree char *string = g_strdup_printf("%" G_GINT64_FORMAT, value);
+  cobalt_state_set_string(state, group, key, string);
+}
+
+gboolean cobalt_state_save(CobaltState *state, GError **error) {
+  if (!state->dirty) {
+    return TRUE;
+  }
+
+  g_autofree char *parent = g_path_get_dirname(state->path);
+  if (g_mkdir_with_parents(parent, 0700) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", parent, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  if (!g_key_file_save_to_file(state->key_file, state->path, error)) {
+    g_prefix_error(error, "Failed to save state file '%s': ", state->path);
+    return FALSE;
+  }
+
+  state->dirty = FALSE;
+  return TRUE;
+}
+
+void cobalt_state_free(CobaltState *state) {
+  g_clear_pointer(&state->path, g_free);
+  g_clear_pointer(&state->key_file, g_key_file_unref);
+  g_free(state);
+}
@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+// State is a small key file that cobalt uses to remember things between
+// launches, e.g. fingerprints used to detect runtime changes. Everything in it
+// must be safe to lose: a missing or corrupt file is treated as empty.
+
+typedef struct CobaltState CobaltState;
+
+CobaltState *cobalt_state_load(const char *name);
+
+// Returns NULL if the key is not set.
+char *cobalt_state_get_string(CobaltState *state, const char *group, const char *key);
+void cobalt_state_set_string(CobaltState *state, const char *group, const char *key,
+                             const char *value);
+
+gint64 cobalt_state_get_int64(CobaltState *state, const char *group, const char *key,
+                              gint64 default_value);
+void cobalt_state_set_int64(CobaltState *state, const char *group, const char *key,
+                            gint64 value);
+
+// Writes the state back to disk, if it was changed since it was loaded.
+gboolean cobalt_state_save(CobaltState *state, GError **error);
+
+void cobalt_state_free(CobaltState *state);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CobaltState, cobalt_state_free)
@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-supervisor.h"
+
+#include "cobalt-session.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+
+// Chromium's RESULT_CODE_NORMAL_EXIT_PROCESS_NOTIFIED, which a browser exits
+// with after handing its command line off to an instance that's already running.
+#define EXIT_STATUS_PROCESS_NOTIFIED 21
+
+static volatile sig_atomic_t stop_signal = 0;
+static volatile pid_t browser_pid = 0;
+
+static void handle_stop_signal(int signum) {
+  stop_signal = signum;
+  if (browser_pid > 0) {
+    kill(browser_pid, signum);
+  }
+}
+
+static void install_signal_handlers(void) {
+  struct sigaction action = {.sa_handler = handle_stop_signal};
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+}
+
+static int wait_for_browser(GPid pid) {
+  int status = 0;
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR) {
+      g_warning("Failed to wait for browser: %s", g_strerror(errno));
+      return 1;
+    }
+  }
+
+  return status;
+}
+
+// Converts a wait status into what a shell would report for it.
+static int get_exit_status(int status) {
+  return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+// Sleeps for the given time, unless a stop signal arrives first.
+static void sleep_unless_stopped(guint milliseconds) {
+  struct timespec remaining = {
+      .tv_sec = milliseconds / 1000,
+      .tv_nsec = (long)(milliseconds % 1000) * 1000 * 1000,
+  };
+
+  while (!stop_signal && nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+  }
+}
+
+int cobalt_supervisor_run(CobaltConfig *config, CobaltLauncher *launcher,
+                          const char *profile_dir,
+                          CobaltSupervisorRestartFunc restart_func, gpointer user_data) {
+  install_signal_handlers();
+
+  // When each crash within the last crash loop window happened.
+  g_autoptr(GArray) recent_crashes = g_array_new(FALSE, FALSE, sizeof(gint64));
+  guint consecutive_crashes = 0;
+  gint64 window = (gint64)config->supervisor.crash_loop_window * G_TIME_SPAN_SECOND;
+
+  for (;;) {
+    g_autoptr(GError) error = NULL;
+    gint64 start = g_get_monotonic_time();
+
+    GPid pid = cobalt_launcher_spawn(launcher, NULL, &error);
+    if (pid == 0) {
+      g_critical("%s", error->message);
+      return 1;
+    }
+
+    browser_pid = pid;
+    // The signal may have arrived before there was anyone to forward it to.
+    if (stop_signal) {
+      kill(pid, stop_signal);
+    }
+
+    int status = wait_for_browser(pid);
+    browser_pid = 0;
+
+    if (stop_signal) {
+      g_debug("Browser stopped by signal %d", stop_signal);
+      return get_exit_status(status);
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+      g_debug("Browser exited normally");
+      return 0;
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_STATUS_PROCESS_NOTIFIED) {
+      g_debug("Browser handed off to the running instance");
+      return 0;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    if (WIFSIGNALED(status)) {
+      g_warning("Browser was killed by signal %d after %" G_GINT64_FORMAT "s",
+                WTERMSIG(status), (now - start) / G_TIME_SPAN_SECOND);
+    } else {
+      g_warning("Browser exited with status %d after %" G_GINT64_FORMAT "s",
+                WEXITSTATUS(status), (now - start) / G_TIME_SPAN_SECOND);
+    }
+
+    // A browser that stayed up for a whole window is considered stable again.
+    if (now - start >= window) {
+      consecutive_crashes = 0;
+    }
+    consecutive_crashes++;
+
+    while (recent_crashes->len > 0 &&
+           now - g_array_index(recent_crashes, gint64, 0) >= window) {
+      g_array_remove_index(recent_crashes, 0);
+    }
+    g_array_append_val(recent_crashes, now);
+
+    if (config->supervisor.crash_loop_limit != 0 &&
+        recent_crashes->len >= config->supervisor.crash_loop_limit) {
+      g_critical("Browser crashed %u times within %us, giving up", recent_crashes->len,
+                 config->supervisor.crash_loop_window);
+      return get_exit_status(status);
+    }
+
+    // Shifting by more than this can't make a difference once capped anyway.
+    guint shift = MIN(consecutive_crashes - 1, 20);
+    guint backoff = MIN((guint64)config->supervisor.initial_backoff << shift,
+                        config->supervisor.max_backoff);
+
+    if (config->supervisor.clean_sessions && profile_dir != NULL) {
+      // A page that took the browser down shouldn't be restored straight into
+      // the next attempt.
+      cobalt_session_remove(profile_dir);
+    }
+
+    g_debug("Restarting browser in %ums", backoff);
+    sleep_unless_stopped(backoff);
+    if (stop_signal) {
+      return get_exit_status(status);
+    }
+
+    if (restart_func != NULL && !restart_func(user_data, &error)) {
+      g_critical("Failed to prepare restart: %s", error->message);
+      return get_exit_status(status);
+    }
+  }
+}
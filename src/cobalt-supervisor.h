@@ -0,0 +1,23 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+#include "cobalt-launcher.h"
+
+#include <glib.h>
+
+// Called right before every restart, to redo whatever the launch set up that may
+// have been undone while no browser was running. If it fails, the browser is not
+// restarted.
+typedef gboolean (*CobaltSupervisorRestartFunc)(gpointer user_data, GError **error);
+
+// Runs the browser from an already prepared launcher as a child process, and
+// restarts it whenever it exits abnormally, according to [Supervisor].
+// profile_dir may be NULL, in which case session state is never cleaned up.
+// restart_func may be NULL. Returns the exit status to exit cobalt with.
+int cobalt_supervisor_run(CobaltConfig *config, CobaltLauncher *launcher,
+                          const char *profile_dir,
+                          CobaltSupervisorRestartFunc restart_func, gpointer user_data);
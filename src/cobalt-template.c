@@ -0,0 +1,117 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-template.h"
+
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEMPORARY_SUFFIX ".cobalt-template-XXXXXX"
+
+// Left behind if the template was made from a profile that was still in use,
+// and would make the browser think the new profile is.
+#define SINGLETON_PREFIX "Singleton"
+
+static gboolean copy_tree(const char *source, const char *dest, GError **error) {
+  struct stat st;
+  if (lstat(source, &st) == -1) {
+    return cobalt_util_set_error_from_errno(error, "stat", source);
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    // The temporary root directory already exists.
+    if (mkdir(dest, st.st_mode & 07777) == -1 && errno != EEXIST) {
+      return cobalt_util_set_error_from_errno(error, "create", dest);
+    }
+
+    g_autoptr(GDir) dir = g_dir_open(source, 0, error);
+    if (dir == NULL) {
+      return FALSE;
+    }
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+      if (g_str_has_prefix(name, SINGLETON_PREFIX)) {
+        continue;
+      }
+
+      g_autofree char *child_source = g_build_filename(source, name, NULL);
+      g_autofree char *child_dest = g_build_filename(dest, name, NULL);
+      if (!copy_tree(child_source, child_dest, error)) {
+        return FALSE;
+      }
+    }
+  } else if (S_ISLNK(st.st_mode)) {
+    g_autofree char *target = g_file_read_link(source, error);
+    if (target == NULL) {
+      return FALSE;
+    }
+
+    if (symlink(target, dest) == -1) {
+      return cobalt_util_set_error_from_errno(error, "create", dest);
+    }
+  } else if (S_ISREG(st.st_mode)) {
+    if (!cobalt_util_copy_file(source, dest, FALSE, error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+gboolean cobalt_template_clone(const char *template_dir, const char *profile_dir,
+                               GError **error) {
+  if (g_file_test(profile_dir, G_FILE_TEST_EXISTS)) {
+    return TRUE;
+  }
+
+  g_autofree char *parent = g_path_get_dirname(profile_dir);
+  if (g_mkdir_with_parents(parent, 0700) == -1) {
+    return cobalt_util_set_error_from_errno(error, "create", parent);
+  }
+
+  // Must be on the same filesystem as the profile, so it can be renamed into
+  // place.
+  g_autofree char *tmp_dir = g_strconcat(profile_dir, TEMPORARY_SUFFIX, NULL);
+  if (g_mkdtemp(tmp_dir) == NULL) {
+    return cobalt_util_set_error_from_errno(error, "create", tmp_dir);
+  }
+
+  gint64 start = g_get_monotonic_time();
+  g_debug("Creating profile '%s' from template '%s'", profile_dir, template_dir);
+
+  if (!copy_tree(template_dir, tmp_dir, error)) {
+    g_autoptr(GError) local_error = NULL;
+    if (!cobalt_util_remove_tree(tmp_dir, &local_error)) {
+      g_warning("%s", local_error->message);
+    }
+
+    return FALSE;
+  }
+
+  if (rename(tmp_dir, profile_dir) == -1) {
+    int saved_errno = errno;
+    g_autoptr(GError) local_error = NULL;
+    if (!cobalt_util_remove_tree(tmp_dir, &local_error)) {
+      g_warning("%s", local_error->message);
+    }
+
+    // Another launch created the profile in the meantime, which is just as
+    // good.
+    if (saved_errno == EEXIST || saved_errno == ENOTEMPTY) {
+      return TRUE;
+    }
+
+    errno = saved_errno;
+    return cobalt_util_set_error_from_errno(error, "move into place", tmp_dir);
+  }
+
+  g_debug("Created profile from template in %" G_GINT64_FORMAT "ms",
+          (g_get_monotonic_time() - start) / G_TIME_SPAN_MILLISECOND);
+  return TRUE;
+}
@@ -0,0 +1,14 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+// Creates the profile at profile_dir as a copy of the pre-seeded profile at
+// template_dir, unless profile_dir already exists. The copy is built next to
+// profile_dir and only moved into place once it's complete, so an interrupted
+// copy is never mistaken for a profile.
+gboolean cobalt_template_clone(const char *template_dir, const char *profile_dir,
+                               GError **error);
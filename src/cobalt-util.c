@@ -0,0 +1,267 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <limits.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#define COPY_BUFFER_SIZE (128 * 1024)
+
+#define ROOT_OVERRIDE_ENV "COBALT_ROOT_OVERRIDE"
+
+#define SYSFS_OVERRIDE_ENV "COBALT_SYSFS_OVERRIDE"
+#define SYSFS_PATH "/sys"
+
+#define MEMINFO_PATH "/proc/meminfo"
+
+gboolean cobalt_util_set_error_from_errno(GError **error, const char *action,
+                                          const char *path) {
+  int saved_errno = errno;
+  g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+              "Failed to %s '%s': %s", action, path, g_strerror(saved_errno));
+  return FALSE;
+}
+
+char *cobalt_util_get_root_path(const char *path) {
+  const char *root = g_getenv(ROOT_OVERRIDE_ENV);
+  if (root == NULL) {
+    return g_strdup(path);
+  }
+
+  return g_build_filename(root, path, NULL);
+}
+
+char *cobalt_util_get_sysfs_path(const char *path) {
+  const char *root = g_getenv(SYSFS_OVERRIDE_ENV);
+  if (root == NULL) {
+    root = SYSFS_PATH;
+  }
+
+  return g_build_filename(root, path, NULL);
+}
+
+gboolean cobalt_util_read_uint64_file(const char *path, guint64 *value, GError **error) {
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, error)) {
+    return FALSE;
+  }
+
+  if (!g_ascii_string_to_unsigned(g_strstrip(contents), 10, 0, G_MAXUINT64, value,
+                                  error)) {
+    g_prefix_error(error, "Failed to parse '%s': ", path);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+gboolean cobalt_util_read_meminfo(const char *field, guint64 *value, GError **error) {
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(MEMINFO_PATH, &contents, NULL, error)) {
+    return FALSE;
+  }
+
+  // Every line looks like "MemAvailable:   1234 kB".
+  g_autofree char *prefix = g_strdup_printf("%s:", field);
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (char **line = lines; *line != NULL; line++) {
+    if (!g_str_has_prefix(*line, prefix)) {
+      continue;
+    }
+
+    char *end = NULL;
+    guint64 kib = g_ascii_strtoull(*line + strlen(prefix), &end, 10);
+    if (end == *line + strlen(prefix)) {
+      break;
+    }
+
+    *value = kib * 1024;
+    return TRUE;
+  }
+
+  g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Failed to find %s in %s",
+              field, MEMINFO_PATH);
+  return FALSE;
+}
+
+gboolean cobalt_util_get_free_space(const char *path, guint64 *free_space,
+                                    GError **error) {
+  struct statvfs st;
+  if (statvfs(path, &st) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to stat filesystem of '%s': %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  *free_space = (guint64)st.f_bavail * st.f_frsize;
+  return TRUE;
+}
+
+static gboolean copy_file_contents(int source_fd, int dest_fd, const char *dest,
+                                   GError **error) {
+  // On btrfs and XFS, a clone shares the source's extents instead of copying
+  // any data at all.
+  if (ioctl(dest_fd, FICLONE, source_fd) == 0) {
+    return TRUE;
+  }
+
+  // copy_file_range lets the kernel (or the server, on NFS) do the copy without
+  // bouncing the data through userspace, but it's not supported everywhere.
+  for (;;) {
+    ssize_t copied = copy_file_range(source_fd, NULL, dest_fd, NULL, SSIZE_MAX, 0);
+    if (copied == 0) {
+      return TRUE;
+    } else if (copied == -1) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                 errno == EOPNOTSUPP) {
+        break;
+      }
+
+      return cobalt_util_set_error_from_errno(error, "copy to", dest);
+    }
+  }
+
+  g_autofree char *buffer = g_malloc(COPY_BUFFER_SIZE);
+  for (;;) {
+    ssize_t bytes_read = read(source_fd, buffer, COPY_BUFFER_SIZE);
+    if (bytes_read == 0) {
+      return TRUE;
+    } else if (bytes_read == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return cobalt_util_set_error_from_errno(error, "copy to", dest);
+    }
+
+    for (ssize_t offset = 0; offset < bytes_read;) {
+      ssize_t written = write(dest_fd, buffer + offset, bytes_read - offset);
+      if (written == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return cobalt_util_set_error_from_errno(error, "write", dest);
+      }
+
+      offset += written;
+    }
+  }
+}
+
+gboolean cobalt_util_copy_file(const char *source, const char *dest, gboolean sync,
+                               GError **error) {
+  int source_fd = open(source, O_RDONLY | O_CLOEXEC);
+  if (source_fd == -1) {
+    return cobalt_util_set_error_from_errno(error, "open", source);
+  }
+
+  struct stat st;
+  if (fstat(source_fd, &st) == -1) {
+    cobalt_util_set_error_from_errno(error, "stat", source);
+    close(source_fd);
+    return FALSE;
+  }
+
+  int dest_fd =
+      open(dest, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & ~S_IFMT);
+  if (dest_fd == -1) {
+    cobalt_util_set_error_from_errno(error, "create", dest);
+    close(source_fd);
+    return FALSE;
+  }
+
+  gboolean success = copy_file_contents(source_fd, dest_fd, dest, error);
+  if (success) {
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (futimens(dest_fd, times) == -1) {
+      success = cobalt_util_set_error_from_errno(error, "set timestamps of", dest);
+    } else if (sync && fsync(dest_fd) == -1) {
+      success = cobalt_util_set_error_from_errno(error, "sync", dest);
+    }
+  }
+
+  close(source_fd);
+  if (close(dest_fd) == -1 && success) {
+    success = cobalt_util_set_error_from_errno(error, "close", dest);
+  }
+
+  if (!success) {
+    unlink(dest);
+  }
+
+  return success;
+}
+
+int cobalt_util_open_lock(const char *path, int operation, GError **error) {
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    cobalt_util_set_error_from_errno(error, "open", path);
+    return -1;
+  }
+
+  while (flock(fd, operation) == -1) {
+    if (errno == EINTR) {
+      continue;
+    }
+
+    cobalt_util_set_error_from_errno(error, "lock", path);
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+gboolean cobalt_util_remove_tree(const char *path, GError **error) {
+  struct stat st;
+  if (lstat(path, &st) == -1) {
+    if (errno == ENOENT) {
+      return TRUE;
+    }
+
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to stat '%s': %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    g_autoptr(GDir) dir = g_dir_open(path, 0, error);
+    if (dir == NULL) {
+      return FALSE;
+    }
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+      g_autofree char *child = g_build_filename(path, name, NULL);
+      if (!cobalt_util_remove_tree(child, error)) {
+        return FALSE;
+      }
+    }
+  }
+
+  if (g_remove(path) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to remove '%s': %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
@@ -0,0 +1,39 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <glib.h>
+
+// Sets error from errno as "Failed to ACTION 'PATH': ...", and returns FALSE.
+gboolean cobalt_util_set_error_from_errno(GError **error, const char *action,
+                                          const char *path);
+
+// Returns the given absolute path inside the sandbox, which can be relocated via
+// COBALT_ROOT_OVERRIDE, e.g. to benchmark against a fabricated Flatpak.
+char *cobalt_util_get_root_path(const char *path);
+
+// Returns the path of the given file under /sys, which can be overridden via
+// COBALT_SYSFS_OVERRIDE, e.g. to test against a fabricated topology.
+char *cobalt_util_get_sysfs_path(const char *path);
+
+gboolean cobalt_util_read_uint64_file(const char *path, guint64 *value, GError **error);
+
+// Reads a field of /proc/meminfo, e.g. "MemAvailable", in bytes.
+gboolean cobalt_util_read_meminfo(const char *field, guint64 *value, GError **error);
+
+gboolean cobalt_util_get_free_space(const char *path, guint64 *free_space,
+                                    GError **error);
+
+// Copies a regular file's contents, mode and timestamps, as a reflink if the
+// filesystem supports it. The destination must not exist yet.
+gboolean cobalt_util_copy_file(const char *source, const char *dest, gboolean sync,
+                               GError **error);
+
+// Opens (creating it if needed) and flock()s the given lock file with the given
+// operation, retrying if interrupted. Returns the locked fd, or -1 on error,
+// which is G_IO_ERROR_WOULD_BLOCK if LOCK_NB was given and the lock is taken.
+int cobalt_util_open_lock(const char *path, int operation, GError **error);
+
+gboolean cobalt_util_remove_tree(const char *path, GError **error);
@@ -0,0 +1,239 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "cobalt-watchdog.h"
+
+#include "cobalt-helper.h"
+#include "cobalt-proc.h"
+#include "cobalt-profile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_FILE_FORMAT "cobalt-%s-watchdog.log"
+// The previous log is kept under this suffix once the current one is full, so
+// at most twice the maximum size is ever used.
+#define LOG_OLD_SUFFIX ".old"
+
+#define POLL_INTERVAL (G_USEC_PER_SEC / 4)
+
+#define PROC_PATH "/proc"
+
+static const char *PRESSURE_FILES[] = {
+    "/proc/pressure/cpu",
+    "/proc/pressure/memory",
+    "/proc/pressure/io",
+    NULL,
+};
+
+// Kept as "PHASE=MILLISECONDS" strings, which is how they're passed to the
+// helper.
+static GPtrArray *phases = NULL;
+static gint64 phase_origin = 0;
+
+void cobalt_watchdog_mark_phase(const char *phase) {
+  gint64 now = g_get_monotonic_time();
+  if (phases == NULL) {
+    phases = g_ptr_array_new_with_free_func(g_free);
+    phase_origin = now;
+  }
+
+  gint64 elapsed_ms = (now - phase_origin) / 1000;
+  g_debug("Reached launch phase '%s' after %" G_GINT64_FORMAT "ms", phase, elapsed_ms);
+  g_ptr_array_add(phases, g_strdup_printf("%s=%" G_GINT64_FORMAT, phase, elapsed_ms));
+}
+
+gboolean cobalt_watchdog_start(CobaltConfig *config, const char *profile_dir,
+                               GError **error) {
+  g_autofree char *log_filename =
+      g_strdup_printf(LOG_FILE_FORMAT, config->application.name);
+  g_autofree char *log_path =
+      g_build_filename(g_get_user_cache_dir(), log_filename, NULL);
+
+  g_autoptr(GPtrArray) args = g_ptr_array_new_with_free_func(g_free);
+  g_ptr_array_add(args, g_strdup_printf("%d", getpid()));
+  g_ptr_array_add(args, g_strdup(profile_dir));
+  g_ptr_array_add(args, g_strdup_printf("%u", config->watchdog.budget));
+  g_ptr_array_add(args, g_steal_pointer(&log_path));
+  g_ptr_array_add(
+      args, g_strdup_printf("%" G_GUINT64_FORMAT, config->watchdog.max_log_size_kb));
+  for (guint i = 0; phases != NULL && i < phases->len; i++) {
+    g_ptr_array_add(args, g_strdup(phases->pdata[i]));
+  }
+  g_ptr_array_add(args, NULL);
+
+  return cobalt_helper_spawnv(COBALT_WATCHDOG_HELPER_RUN,
+                              (const char *const *)args->pdata, error);
+}
+
+static char *read_proc_file(pid_t pid, const char *name) {
+  g_autofree char *path = g_strdup_printf(PROC_PATH "/%d/%s", pid, name);
+  g_autofree char *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return NULL;
+  }
+
+  return g_strdup(g_strchomp(contents));
+}
+
+static void append_indented(GString *snapshot, const char *indent, const char *text) {
+  g_auto(GStrv) lines = g_strsplit(text, "\n", -1);
+  for (char **line = lines; *line != NULL; line++) {
+    g_string_append_printf(snapshot, "%s%s\n", indent, *line);
+  }
+}
+
+static void append_process(GString *snapshot, pid_t pid) {
+  g_autofree char *comm = read_proc_file(pid, "comm");
+  g_autofree char *type = cobalt_proc_get_chromium_type(pid);
+  // Where the process is blocked in the kernel, or "0" if it's running.
+  g_autofree char *wchan = read_proc_file(pid, "wchan");
+  g_string_append_printf(snapshot, "  %d %s (%s) wchan=%s\n", pid,
+                         comm != NULL ? comm : "?", type != NULL ? type : "?",
+                         wchan != NULL ? wchan : "?");
+
+  g_autofree char *io = read_proc_file(pid, "io");
+  if (io != NULL) {
+    g_auto(GStrv) counters = g_strsplit(io, "\n", -1);
+    g_autofree char *joined = g_strjoinv(", ", counters);
+    g_string_append_printf(snapshot, "    io: %s\n", joined);
+  }
+
+  // Usually only readable with CAP_SYS_ADMIN.
+  g_autofree char *stack = read_proc_file(pid, "stack");
+  if (stack != NULL && *stack != '\0') {
+    g_string_append(snapshot, "    stack:\n");
+    append_indented(snapshot, "      ", stack);
+  }
+}
+
+static GString *take_snapshot(pid_t root, guint budget, int phase_count,
+                              char **phase_args) {
+  g_autoptr(GDateTime) now = g_date_time_new_now_utc();
+  g_autofree char *timestamp = g_date_time_format_iso8601(now);
+
+  GString *snapshot = g_string_new(NULL);
+  g_string_append_printf(snapshot,
+                         "=== %s: browser (pid %d) did not start within %us ===\n",
+                         timestamp, root, budget);
+
+  g_string_append(snapshot, "Launch phases (ms):\n");
+  for (int i = 0; i < phase_count; i++) {
+    g_string_append_printf(snapshot, "  %s\n", phase_args[i]);
+  }
+
+  g_string_append(snapshot, "Pressure:\n");
+  for (const char **file = PRESSURE_FILES; *file != NULL; file++) {
+    g_autofree char *contents = NULL;
+    if (g_file_get_contents(*file, &contents, NULL, NULL)) {
+      g_string_append_printf(snapshot, "  %s:\n", *file);
+      append_indented(snapshot, "    ", g_strchomp(contents));
+    }
+  }
+
+  g_string_append(snapshot, "Processes:\n");
+  g_autoptr(GArray) tree = cobalt_proc_list_tree(root);
+  for (guint i = 0; i < tree->len; i++) {
+    append_process(snapshot, g_array_index(tree, pid_t, i));
+  }
+
+  g_string_append_c(snapshot, '\n');
+  return snapshot;
+}
+
+static gboolean append_to_log(const char *log_path, guint64 max_size, GString *snapshot,
+                              GError **error) {
+  g_autofree char *log_dir = g_path_get_dirname(log_path);
+  if (g_mkdir_with_parents(log_dir, 0700) == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to create '%s': %s", log_dir, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  struct stat st;
+  if (stat(log_path, &st) == 0 && st.st_size + snapshot->len > max_size) {
+    g_autofree char *old_path = g_strconcat(log_path, LOG_OLD_SUFFIX, NULL);
+    if (rename(log_path, old_path) == -1) {
+      int saved_errno = errno;
+      g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                  "Failed to rotate '%s': %s", log_path, g_strerror(saved_errno));
+      return FALSE;
+    }
+  }
+
+  int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Failed to open '%s': %s", log_path, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  // A single snapshot larger than the limit is cut off rather than dropped.
+  gsize remaining = MIN(snapshot->len, max_size);
+  const char *data = snapshot->str;
+  while (remaining > 0) {
+    ssize_t written = write(fd, data, remaining);
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      int saved_errno = errno;
+      g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                  "Failed to write '%s': %s", log_path, g_strerror(saved_errno));
+      close(fd);
+      return FALSE;
+    }
+
+    data += written;
+    remaining -= written;
+  }
+
+  close(fd);
+  return TRUE;
+}
+
+int cobalt_watchdog_helper_run(int argc, char **argv) {
+  if (argc < 5) {
+    g_printerr("usage: " COBALT_WATCHDOG_HELPER_RUN
+               " PID PROFILE-DIR BUDGET LOG-PATH MAX-LOG-SIZE-KB [PHASE=MS...]\n");
+    return 1;
+  }
+
+  pid_t root = g_ascii_strtoll(argv[0], NULL, 10);
+  const char *profile_dir = argv[1];
+  guint budget = g_ascii_strtoull(argv[2], NULL, 10);
+  const char *log_path = argv[3];
+  guint64 max_log_size = g_ascii_strtoull(argv[4], NULL, 10) * 1024;
+
+  // The singleton socket is set up early in the browser's startup, before the
+  // profile is loaded or any window is shown, so this only catches launches that
+  // stall before getting there. A launch that's handed off to an already running
+  // instance exits right away. The singleton lock isn't trusted here: after a
+  // crash, it's left behind naming the PID the sandbox reuses, which is usually
+  // the very browser being watched.
+  gint64 deadline = g_get_monotonic_time() + budget * G_USEC_PER_SEC;
+  while (g_get_monotonic_time() < deadline) {
+    if (!cobalt_proc_is_alive(root) || cobalt_profile_is_listening(profile_dir)) {
+      return 0;
+    }
+
+    g_usleep(POLL_INTERVAL);
+  }
+
+  g_autoptr(GString) snapshot = take_snapshot(root, budget, argc - 5, argv + 5);
+
+  g_autoptr(GError) error = NULL;
+  if (!append_to_log(log_path, max_log_size, snapshot, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  return 0;
+}
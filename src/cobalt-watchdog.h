@@ -0,0 +1,25 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "cobalt-config.h"
+
+#include <glib.h>
+
+#define COBALT_WATCHDOG_HELPER_RUN "startup-watchdog"
+
+// Records how long it took cobalt to reach the given phase of the launch, which
+// is included in any snapshot the watchdog takes. The first phase marked is the
+// starting point for all later ones.
+void cobalt_watchdog_mark_phase(const char *phase);
+
+// Starts a helper that waits for the browser this process is about to exec
+// into to take ownership of profile_dir, and if that doesn't happen within
+// [Watchdog] Budget, appends a diagnostic snapshot of the browser's process
+// tree to the watchdog log.
+gboolean cobalt_watchdog_start(CobaltConfig *config, const char *profile_dir,
+                               GError **error);
+
+int cobalt_watchdog_helper_run(int argc, char **argv);